@@ -0,0 +1,34 @@
+#include <SDL3/SDL_iostream.h>
+
+#include <backend/SDL3/font.hpp>
+
+using namespace backend;
+
+SDL3_Fonts::SDL3_Fonts(engine::FontRegistry& registry)
+{
+  _fonts.reserve(registry.size());
+  for (auto i = 0UL; i < registry.size(); i++) {
+    const auto id = static_cast<int>(i);
+    const auto& file = registry.file(id);
+    auto* io = SDL_IOFromConstMem(file.data(), file.size());
+    auto* font = io == nullptr
+        ? nullptr
+        : TTF_OpenFontIO(io, true, registry.font(id).size);
+    if (font != nullptr) {
+      registry.set_metrics(id,
+                           {TTF_GetFontAscent(font),
+                            TTF_GetFontDescent(font),
+                            TTF_GetFontHeight(font)});
+    }
+    _fonts.push_back(font);
+  }
+}
+
+SDL3_Fonts::~SDL3_Fonts()
+{
+  for (auto* font : _fonts) {
+    if (font != nullptr) {
+      TTF_CloseFont(font);
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include <SDL3_ttf/SDL_ttf.h>
+
+#include <engine/font.hpp>
+
+namespace backend
+{
+// Opens one TTF_Font per registry id straight from the mapped file bytes and
+// writes the metrics back into the registry. The registry must outlive this.
+class SDL3_Fonts
+{
+public:
+  explicit SDL3_Fonts(engine::FontRegistry& registry);
+  ~SDL3_Fonts();
+
+  // nullptr when the id is unknown or the font failed to open
+  TTF_Font* get(int id) const
+  {
+    return id < 0 || static_cast<std::size_t>(id) >= _fonts.size()
+        ? nullptr
+        : _fonts[static_cast<std::size_t>(id)];
+  }
+  std::size_t size() const { return _fonts.size(); }
+
+protected:
+  SDL3_Fonts(const SDL3_Fonts&) = delete;
+  SDL3_Fonts& operator=(const SDL3_Fonts&) = delete;
+
+private:
+  std::vector<TTF_Font*> _fonts;
+};
+}  // namespace backend
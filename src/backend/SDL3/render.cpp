@@ -1,3 +1,82 @@
 #include <backend/SDL3/render.hpp>
 
-void backend::SDL3_Render() {}
\ No newline at end of file
+using namespace backend;
+
+bool backend::SDL3_Render(SDL_Renderer* renderer,
+                          SDL_Texture* texture,
+                          const Framebuffer& fb,
+                          std::span<const ClipRect> dirty)
+{
+  if (dirty.empty()) {
+    return false;
+  }
+
+  const auto pitch = fb.pitch * static_cast<int>(sizeof(*fb.pixels));
+  for (const auto& r : dirty) {
+    const SDL_Rect rect {r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0};
+    SDL_UpdateTexture(texture,
+                      &rect,
+                      fb.pixels + static_cast<std::ptrdiff_t>(r.y0) * fb.pitch
+                          + r.x0,
+                      pitch);
+  }
+  SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+  return true;
+}
+
+void SDL3_RectBatcher::push(const engine::Rect& r, const SDL_FColor& c)
+{
+  const auto x0 = r.x();
+  const auto y0 = r.y();
+  const auto x1 = r.x() + r.z();
+  const auto y1 = r.y() + r.w();
+  _vertices.push_back({{x0, y0}, c, {0, 0}});
+  _vertices.push_back({{x1, y0}, c, {0, 0}});
+  _vertices.push_back({{x1, y1}, c, {0, 0}});
+  _vertices.push_back({{x0, y1}, c, {0, 0}});
+}
+
+void SDL3_RectBatcher::flush(SDL_Renderer* renderer)
+{
+  if (_vertices.empty()) {
+    return;
+  }
+  const auto nrects = _vertices.size() / 4;
+  for (auto i = _indices.size() / 6; i < nrects; i++) {
+    const auto v = static_cast<int>(i * 4);
+    for (auto idx : {v, v + 1, v + 2, v, v + 2, v + 3}) {
+      _indices.push_back(idx);
+    }
+  }
+  SDL_RenderGeometry(renderer,
+                     nullptr,
+                     _vertices.data(),
+                     static_cast<int>(_vertices.size()),
+                     _indices.data(),
+                     static_cast<int>(nrects * 6));
+  _vertices.clear();
+}
+
+void SDL3_RectBatcher::render(SDL_Renderer* renderer,
+                              const engine::CommandBuffer& commands,
+                              SDL3_TextRenderer& text)
+{
+  for (const auto& cmd : commands) {
+    switch (cmd.type) {
+      case engine::CommandType::Rectangle: {
+        text.flush();
+        const auto& rc = static_cast<const engine::RectCommand&>(cmd);
+        push(rc.bbox, {rc.c.x(), rc.c.y(), rc.c.z(), rc.c.w()});
+        if (_vertices.size() >= max_batch * 4) {
+          flush(renderer);
+        }
+      } break;
+      case engine::CommandType::Text:
+        flush(renderer);
+        text.draw(static_cast<const engine::TextCommand&>(cmd));
+        break;
+    }
+  }
+  flush(renderer);
+  text.flush();
+}
@@ -1,6 +1,48 @@
 #pragma once
 
+#include <span>
+#include <vector>
+
+#include <SDL3/SDL_render.h>
+
+#include <backend/SDL3/text.hpp>
+#include <backend/software/raster.hpp>
+#include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
+
 namespace backend
 {
-  void SDL3_Render();
-}
\ No newline at end of file
+// Uploads only the dirty rectangles of the software framebuffer into a
+// streaming texture of the same size, then draws the texture over the whole
+// render target. Returns false without touching the renderer when nothing is
+// dirty, in which case the caller can skip presenting the frame.
+bool SDL3_Render(SDL_Renderer* renderer,
+                 SDL_Texture* texture,
+                 const Framebuffer& fb,
+                 std::span<const ClipRect> dirty);
+
+// Draws rectangles on the GPU without the software rasterizer. Every run of
+// consecutive rectangle commands is merged into one vertex buffer and
+// submitted with a single SDL_RenderGeometry call; the pending batch is
+// flushed before any text command so submission order is kept.
+class SDL3_RectBatcher
+{
+public:
+  static constexpr std::size_t max_batch = 16384;
+
+  // Text is batched too, each run of consecutive text commands becomes one
+  // draw call on the glyph atlas
+  void render(SDL_Renderer* renderer,
+              const engine::CommandBuffer& commands,
+              SDL3_TextRenderer& text);
+
+private:
+  void push(const engine::Rect& r, const SDL_FColor& c);
+  void flush(SDL_Renderer* renderer);
+
+  std::vector<SDL_Vertex> _vertices;
+  // two triangles per rectangle, the pattern only depends on the count so it
+  // is built once and shared by every batch
+  std::vector<int> _indices;
+};
+}  // namespace backend
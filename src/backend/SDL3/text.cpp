@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_surface.h>
+
+#include <backend/SDL3/text.hpp>
+
+using namespace backend;
+
+namespace
+{
+// opaque white block in the atlas corner, sampled by solid quads
+constexpr int solid_size = 4;
+constexpr int glyph_padding = 1;
+constexpr int max_shape_attempts = 2;
+
+auto hash_text(std::string_view text) -> std::uint64_t
+{
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  for (auto ch : text) {
+    h ^= static_cast<std::uint8_t>(ch);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+auto pack_color(const engine::Color& c) -> std::uint32_t
+{
+  auto u8 = [](float v)
+  { return static_cast<std::uint32_t>(std::clamp(v, 0.0F, 255.0F)); };
+  return u8(c.x()) | (u8(c.y()) << 8) | (u8(c.z()) << 16) | (u8(c.w()) << 24);
+}
+
+void push_quad(std::vector<SDL_Vertex>& v,
+               SDL_FRect r,
+               SDL_FRect uv,
+               SDL_FColor c)
+{
+  v.push_back({{r.x, r.y}, c, {uv.x, uv.y}});
+  v.push_back({{r.x + r.w, r.y}, c, {uv.x + uv.w, uv.y}});
+  v.push_back({{r.x + r.w, r.y + r.h}, c, {uv.x + uv.w, uv.y + uv.h}});
+  v.push_back({{r.x, r.y + r.h}, c, {uv.x, uv.y + uv.h}});
+}
+}  // namespace
+
+std::size_t SDL3_TextRenderer::KeyHash::operator()(const GlyphKey& k) const
+{
+  return std::hash<std::uint64_t> {}(
+      (static_cast<std::uint64_t>(k.font) << 40)
+      ^ (static_cast<std::uint64_t>(k.size * 64.0F) << 24) ^ k.codepoint);
+}
+
+std::size_t SDL3_TextRenderer::KeyHash::operator()(const RunKey& k) const
+{
+  return std::hash<std::uint64_t> {}(
+      k.hash ^ (static_cast<std::uint64_t>(k.color) << 17)
+      ^ static_cast<std::uint64_t>(k.font));
+}
+
+SDL3_TextRenderer::SDL3_TextRenderer(SDL_Renderer* renderer,
+                                     int atlas_size,
+                                     std::size_t max_runs)
+    : _renderer(renderer)
+    , _atlas(SDL_CreateTexture(renderer,
+                               SDL_PIXELFORMAT_RGBA32,
+                               SDL_TEXTUREACCESS_STATIC,
+                               atlas_size,
+                               atlas_size))
+    , _atlas_size(atlas_size)
+    , _max_runs(max_runs)
+{
+  SDL_SetTextureBlendMode(_atlas, SDL_BLENDMODE_BLEND);
+  reset_atlas();
+}
+
+SDL3_TextRenderer::~SDL3_TextRenderer()
+{
+  SDL_DestroyTexture(_atlas);
+}
+
+void SDL3_TextRenderer::set_font(int id, TTF_Font* font)
+{
+  if (id < 0) {
+    return;
+  }
+  if (static_cast<std::size_t>(id) >= _fonts.size()) {
+    _fonts.resize(static_cast<std::size_t>(id) + 1, nullptr);
+  }
+  _fonts[static_cast<std::size_t>(id)] = font;
+}
+
+void SDL3_TextRenderer::reset_atlas()
+{
+  // queued quads still point at the old atlas contents
+  flush();
+  _glyphs.clear();
+  _runs.clear();
+  _lru.clear();
+  _generation++;
+
+  std::array<std::uint32_t, solid_size * solid_size> white {};
+  white.fill(0xffffffffU);
+  const SDL_Rect solid {0, 0, solid_size, solid_size};
+  SDL_UpdateTexture(_atlas,
+                    &solid,
+                    white.data(),
+                    solid_size * static_cast<int>(sizeof(std::uint32_t)));
+  _shelf_x = solid_size + glyph_padding;
+  _shelf_y = 0;
+  _shelf_h = solid_size;
+}
+
+bool SDL3_TextRenderer::pack(int w, int h, SDL_Rect& dst)
+{
+  if (_shelf_x + w > _atlas_size) {
+    _shelf_y += _shelf_h + glyph_padding;
+    _shelf_x = 0;
+    _shelf_h = 0;
+  }
+  if (w > _atlas_size || _shelf_y + h > _atlas_size) {
+    return false;
+  }
+  dst = {_shelf_x, _shelf_y, w, h};
+  _shelf_x += w + glyph_padding;
+  _shelf_h = std::max(_shelf_h, h);
+  return true;
+}
+
+auto SDL3_TextRenderer::glyph(int font, std::uint32_t codepoint)
+    -> const Glyph*
+{
+  auto* f = _fonts[static_cast<std::size_t>(font)];
+  const GlyphKey key {font, TTF_GetFontSize(f), codepoint};
+  if (auto it = _glyphs.find(key); it != _glyphs.end()) {
+    return &it->second;
+  }
+
+  int minx = 0, maxx = 0, miny = 0, maxy = 0, advance = 0;
+  TTF_GetGlyphMetrics(f, codepoint, &minx, &maxx, &miny, &maxy, &advance);
+
+  Glyph g {{0, 0, 0, 0}, 0, 0, 0, advance};
+  auto* surface = TTF_RenderGlyph_Blended(f, codepoint, {255, 255, 255, 255});
+  auto* rgba = surface == nullptr
+      ? nullptr
+      : SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+  SDL_DestroySurface(surface);
+
+  if (rgba != nullptr && rgba->w > 0 && rgba->h > 0) {
+    SDL_Rect dst;
+    if (!pack(rgba->w, rgba->h, dst)) {
+      reset_atlas();
+      if (!pack(rgba->w, rgba->h, dst)) {
+        SDL_DestroySurface(rgba);
+        return nullptr;
+      }
+    }
+    SDL_UpdateTexture(_atlas, &dst, rgba->pixels, rgba->pitch);
+    const auto inv = 1.0F / static_cast<float>(_atlas_size);
+    g.uv = {static_cast<float>(dst.x) * inv,
+            static_cast<float>(dst.y) * inv,
+            static_cast<float>(dst.w) * inv,
+            static_cast<float>(dst.h) * inv};
+    g.x = static_cast<float>(std::min(minx, 0));
+    g.w = static_cast<float>(dst.w);
+    g.h = static_cast<float>(dst.h);
+  }
+  SDL_DestroySurface(rgba);
+
+  return &_glyphs.emplace(key, g).first->second;
+}
+
+void SDL3_TextRenderer::shape(const engine::TextCommand& tc, Run& run)
+{
+  auto* font = _fonts[static_cast<std::size_t>(tc.font)];
+  const SDL_FColor color {tc.c.x() / 255.0F,
+                          tc.c.y() / 255.0F,
+                          tc.c.z() / 255.0F,
+                          tc.c.w() / 255.0F};
+  const auto inv = 1.0F / static_cast<float>(_atlas_size);
+  const SDL_FRect solid {inv, inv, inv, inv};
+
+  run.text.assign(tc.text, tc.nchar);
+  run.vertices.clear();
+  // background quad first, sized once the pen position is known
+  push_quad(run.vertices, {0, 0, 0, 0}, solid, {0, 0, 0, 127.0F / 255.0F});
+
+  const char* p = tc.text;
+  std::size_t len = tc.nchar;
+  std::uint32_t prev = 0;
+  float pen = 0;
+  while (len > 0) {
+    const auto cp = SDL_StepUTF8(&p, &len);
+    if (cp == 0) {
+      break;
+    }
+    int kerning = 0;
+    if (prev != 0 && TTF_GetGlyphKerning(font, prev, cp, &kerning)) {
+      pen += static_cast<float>(kerning);
+    }
+    if (const auto* g = glyph(tc.font, cp); g != nullptr) {
+      if (g->w > 0) {
+        push_quad(run.vertices, {pen + g->x, 0, g->w, g->h}, g->uv, color);
+      }
+      pen += static_cast<float>(g->advance);
+    }
+    prev = cp;
+  }
+
+  const auto height = static_cast<float>(TTF_GetFontHeight(font));
+  run.vertices[1].position.x = pen;
+  run.vertices[2].position = {pen, height};
+  run.vertices[3].position.y = height;
+}
+
+auto SDL3_TextRenderer::run(const engine::TextCommand& tc) -> const Run&
+{
+  const std::string_view text {tc.text, tc.nchar};
+  const RunKey key {tc.font, hash_text(text), pack_color(tc.c)};
+
+  if (auto it = _runs.find(key); it != _runs.end()) {
+    if (it->second.text == text) {
+      _lru.splice(_lru.begin(), _lru, it->second.lru);
+      return it->second;
+    }
+    // hash collision, the new text replaces the cached run
+    _lru.erase(it->second.lru);
+    _runs.erase(it);
+  }
+
+  Run r;
+  for (auto attempt = 0; attempt < max_shape_attempts; attempt++) {
+    // a full atlas is wiped while shaping, which also drops the glyphs this
+    // run already placed, so shape it again against the fresh atlas
+    const auto generation = _generation;
+    shape(tc, r);
+    if (generation == _generation) {
+      break;
+    }
+  }
+
+  if (_runs.size() >= _max_runs) {
+    _runs.erase(_lru.back());
+    _lru.pop_back();
+  }
+  _lru.push_front(key);
+  r.lru = _lru.begin();
+  return _runs.emplace(key, std::move(r)).first->second;
+}
+
+void SDL3_TextRenderer::draw(const engine::TextCommand& tc)
+{
+  if (tc.font < 0 || static_cast<std::size_t>(tc.font) >= _fonts.size()
+      || _fonts[static_cast<std::size_t>(tc.font)] == nullptr)
+  {
+    return;
+  }
+
+  const auto& r = run(tc);
+  const auto x = tc.bbox.x();
+  const auto y = tc.bbox.y();
+  for (auto v : r.vertices) {
+    v.position.x += x;
+    v.position.y += y;
+    _vertices.push_back(v);
+  }
+}
+
+void SDL3_TextRenderer::flush()
+{
+  if (_vertices.empty()) {
+    return;
+  }
+  const auto nquads = _vertices.size() / 4;
+  for (auto i = _indices.size() / 6; i < nquads; i++) {
+    const auto v = static_cast<int>(i * 4);
+    for (auto idx : {v, v + 1, v + 2, v, v + 2, v + 3}) {
+      _indices.push_back(idx);
+    }
+  }
+  SDL_RenderGeometry(_renderer,
+                     _atlas,
+                     _vertices.data(),
+                     static_cast<int>(_vertices.size()),
+                     _indices.data(),
+                     static_cast<int>(nquads * 6));
+  _vertices.clear();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_render.h>
+#include <SDL3_ttf/SDL_ttf.h>
+
+#include <engine/command.hpp>
+
+namespace backend
+{
+// Draws TextCommands from a glyph atlas. Glyphs are rasterized once per
+// (font, size, codepoint) into a single texture; laid out runs are kept in an
+// LRU cache keyed by (font, text hash, color), so steady-state text only
+// copies cached quads into the pending batch. Text colors are 0..255 like
+// SDL_Color.
+class SDL3_TextRenderer
+{
+public:
+  static constexpr int default_atlas_size = 1024;
+  static constexpr std::size_t default_max_runs = 1024;
+
+  explicit SDL3_TextRenderer(SDL_Renderer* renderer,
+                             int atlas_size = default_atlas_size,
+                             std::size_t max_runs = default_max_runs);
+  ~SDL3_TextRenderer();
+
+  void set_font(int id, TTF_Font* font);
+
+  // Queues the quads of one command; nothing reaches the renderer until
+  // flush()
+  void draw(const engine::TextCommand& tc);
+  void flush();
+  bool pending() const { return !_vertices.empty(); }
+
+protected:
+  SDL3_TextRenderer(const SDL3_TextRenderer&) = delete;
+  SDL3_TextRenderer& operator=(const SDL3_TextRenderer&) = delete;
+
+private:
+  struct GlyphKey
+  {
+    int font;
+    float size;
+    std::uint32_t codepoint;
+
+    bool operator==(const GlyphKey&) const = default;
+  };
+
+  struct Glyph
+  {
+    SDL_FRect uv;
+    float x, w, h;
+    int advance;
+  };
+
+  struct RunKey
+  {
+    int font;
+    std::uint64_t hash;
+    std::uint32_t color;
+
+    bool operator==(const RunKey&) const = default;
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator()(const GlyphKey& k) const;
+    std::size_t operator()(const RunKey& k) const;
+  };
+
+  struct Run
+  {
+    std::string text;
+    std::vector<SDL_Vertex> vertices;  // relative to the command origin
+    std::list<RunKey>::iterator lru;
+  };
+
+  const Glyph* glyph(int font, std::uint32_t codepoint);
+  const Run& run(const engine::TextCommand& tc);
+  void shape(const engine::TextCommand& tc, Run& run);
+  bool pack(int w, int h, SDL_Rect& dst);
+  void reset_atlas();
+
+  SDL_Renderer* _renderer;
+  SDL_Texture* _atlas;
+  int _atlas_size;
+  std::size_t _max_runs;
+
+  // shelf packer state
+  int _shelf_x {0};
+  int _shelf_y {0};
+  int _shelf_h {0};
+  std::size_t _generation {0};
+
+  std::vector<TTF_Font*> _fonts;
+  std::unordered_map<GlyphKey, Glyph, KeyHash> _glyphs;
+  std::unordered_map<RunKey, Run, KeyHash> _runs;
+  std::list<RunKey> _lru;
+
+  std::vector<SDL_Vertex> _vertices;
+  std::vector<int> _indices;
+};
+}  // namespace backend
@@ -0,0 +1,90 @@
+#include <string>
+
+#include <backend/software/frame_sink.hpp>
+
+using namespace backend;
+
+namespace
+{
+// frames are a few MB each, write them out in large chunks
+constexpr std::size_t sink_buffer = 1UL << 20;
+}  // namespace
+
+FrameSink::FrameSink(const std::string& path, Format format)
+    : _format(format)
+{
+  if (path == "-") {
+    _file = stdout;
+  } else {
+    _file = std::fopen(path.c_str(), "wb");
+    _owned = true;
+  }
+  if (_file != nullptr) {
+    std::setvbuf(_file, nullptr, _IOFBF, sink_buffer);
+  }
+}
+
+FrameSink::~FrameSink()
+{
+  if (_file == nullptr) {
+    return;
+  }
+  if (_owned) {
+    std::fclose(_file);
+  } else {
+    std::fflush(_file);
+  }
+}
+
+bool FrameSink::put(const void* data, std::size_t size)
+{
+  if (std::fwrite(data, 1, size, _file) != size) {
+    _failed = true;
+    return false;
+  }
+  _bytes += size;
+  return true;
+}
+
+bool FrameSink::write(const Framebuffer& fb)
+{
+  if (!ok()) {
+    return false;
+  }
+
+  const auto width = static_cast<std::size_t>(fb.width);
+  const auto height = static_cast<std::size_t>(fb.height);
+  const auto pitch = static_cast<std::size_t>(fb.pitch);
+  if (_format == Format::PPM) {
+    const auto header = "P6\n" + std::to_string(width) + " "
+        + std::to_string(height) + "\n255\n";
+    if (!put(header.data(), header.size())) {
+      return false;
+    }
+  }
+
+  for (auto y = 0UL; y < height; y++) {
+    const auto* src = fb.pixels + y * pitch;
+    if (_format == Format::RAW) {
+      if (!put(src, width * sizeof(std::uint32_t))) {
+        return false;
+      }
+      continue;
+    }
+
+    // the pixels are R, G, B, A bytes in memory, PPM wants R, G, B
+    _row.resize(width * 3);
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(src);
+    for (auto x = 0UL; x < width; x++) {
+      _row[x * 3 + 0] = bytes[x * 4 + 0];
+      _row[x * 3 + 1] = bytes[x * 4 + 1];
+      _row[x * 3 + 2] = bytes[x * 4 + 2];
+    }
+    if (!put(_row.data(), _row.size())) {
+      return false;
+    }
+  }
+
+  _frames++;
+  return true;
+}
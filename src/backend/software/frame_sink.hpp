@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <backend/software/raster.hpp>
+
+namespace backend
+{
+// Streams framebuffers to a file, or to stdout for a path of "-", one after
+// the other as they are rendered. PPM writes every frame as a binary P6
+// image, a stream ffmpeg reads with -f image2pipe -c:v ppm. RAW writes the
+// bare RGBA pixels, which ffmpeg reads with -f rawvideo -pix_fmt rgba and the
+// frame size.
+class FrameSink
+{
+public:
+  enum class Format
+  {
+    PPM,
+    RAW
+  };
+
+  FrameSink(const std::string& path, Format format);
+  ~FrameSink();
+
+  // False once opening or a write failed
+  bool ok() const { return _file != nullptr && !_failed; }
+
+  bool write(const Framebuffer& fb);
+
+  std::size_t frames() const { return _frames; }
+  std::size_t bytes() const { return _bytes; }
+
+protected:
+  FrameSink(const FrameSink&) = delete;
+  FrameSink& operator=(const FrameSink&) = delete;
+
+private:
+  bool put(const void* data, std::size_t size);
+
+  std::FILE* _file {nullptr};
+  bool _owned {false};
+  bool _failed {false};
+  Format _format;
+  std::size_t _frames {0};
+  std::size_t _bytes {0};
+  // one row of RGB pixels for PPM
+  std::vector<std::uint8_t> _row;
+};
+}  // namespace backend
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+#include <backend/software/raster.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define RENDER_HAS_SSE2 1
+#endif
+
+using namespace backend;
+
+namespace
+{
+auto to_u8(float v) -> std::uint8_t
+{
+  return static_cast<std::uint8_t>(std::clamp(v, 0.0F, 1.0F) * 255.0F + 0.5F);
+}
+
+// exact x / 255 for x in [0, 255 * 255]
+auto div255(std::uint32_t x) -> std::uint32_t
+{
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+auto alpha_of(std::uint32_t px) -> std::uint32_t
+{
+  return std::bit_cast<std::array<std::uint8_t, 4>>(px)[3];
+}
+
+auto opaque(std::uint32_t px) -> std::uint32_t
+{
+  auto b = std::bit_cast<std::array<std::uint8_t, 4>>(px);
+  b[3] = 255;
+  return std::bit_cast<std::uint32_t>(b);
+}
+
+void fill_span(std::uint32_t* dst, int n, std::uint32_t px)
+{
+  int i = 0;
+#if defined(RENDER_HAS_SSE2)
+  const __m128i v = _mm_set1_epi32(static_cast<int>(px));
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+  }
+#endif
+  for (; i < n; i++) {
+    dst[i] = px;
+  }
+}
+
+// src "over" dst with a constant source color. The alpha byte of src must be
+// 0xff so the alpha channel comes out as a + dst_a * (1 - a).
+void blend_span(std::uint32_t* dst, int n, std::uint32_t src, std::uint32_t a)
+{
+  const std::uint32_t ia = 255 - a;
+  int i = 0;
+#if defined(RENDER_HAS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i s16 = _mm_unpacklo_epi8(
+      _mm_set1_epi32(static_cast<int>(src)), zero);
+  const __m128i sa = _mm_mullo_epi16(
+      s16, _mm_set1_epi16(static_cast<short>(a)));
+  const __m128i va = _mm_set1_epi16(static_cast<short>(ia));
+  const __m128i bias = _mm_set1_epi16(128);
+  auto blend8 = [&](__m128i d16)
+  {
+    __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(d16, va), sa),
+                              bias);
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+  };
+  for (; i + 4 <= n; i += 4) {
+    auto* p = reinterpret_cast<__m128i*>(dst + i);
+    const __m128i d = _mm_loadu_si128(p);
+    const __m128i lo = blend8(_mm_unpacklo_epi8(d, zero));
+    const __m128i hi = blend8(_mm_unpackhi_epi8(d, zero));
+    _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < n; i++) {
+    auto s = std::bit_cast<std::array<std::uint8_t, 4>>(src);
+    auto d = std::bit_cast<std::array<std::uint8_t, 4>>(dst[i]);
+    for (auto k = 0U; k < 4; k++) {
+      d[k] = static_cast<std::uint8_t>(div255(s[k] * a + d[k] * ia));
+    }
+    dst[i] = std::bit_cast<std::uint32_t>(d);
+  }
+}
+
+void fill_covered(Framebuffer& fb, ClipRect cov, std::uint32_t px)
+{
+  const auto x0 = cov.x0;
+  const auto y0 = cov.y0;
+  const auto x1 = cov.x1;
+  const auto y1 = cov.y1;
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  const auto a = alpha_of(px);
+  if (a == 0) {
+    return;
+  }
+  const auto n = x1 - x0;
+  auto* row = fb.pixels + static_cast<std::ptrdiff_t>(y0) * fb.pitch + x0;
+  if (a == 255) {
+    for (auto y = y0; y < y1; y++, row += fb.pitch) {
+      fill_span(row, n, px);
+    }
+  } else {
+    const auto src = opaque(px);
+    for (auto y = y0; y < y1; y++, row += fb.pitch) {
+      blend_span(row, n, src, a);
+    }
+  }
+}
+}  // namespace
+
+auto backend::Software_PackColor(const engine::Color& c) -> std::uint32_t
+{
+  return std::bit_cast<std::uint32_t>(std::array<std::uint8_t, 4> {
+      to_u8(c.x()), to_u8(c.y()), to_u8(c.z()), to_u8(c.w())});
+}
+
+auto backend::Software_Coverage(const engine::Rect& r) -> ClipRect
+{
+  return {static_cast<int>(std::ceil(r.x() - 0.5F)),
+          static_cast<int>(std::ceil(r.y() - 0.5F)),
+          static_cast<int>(std::ceil(r.x() + r.z() - 0.5F)),
+          static_cast<int>(std::ceil(r.y() + r.w() - 0.5F))};
+}
+
+void backend::Software_Clear(Framebuffer& fb, std::uint32_t color)
+{
+  Software_Clear(fb, color, {0, 0, fb.width, fb.height});
+}
+
+void backend::Software_Clear(Framebuffer& fb,
+                             std::uint32_t color,
+                             ClipRect clip)
+{
+  const auto x0 = std::max(clip.x0, 0);
+  const auto x1 = std::min(clip.x1, fb.width);
+  if (x0 >= x1) {
+    return;
+  }
+  for (auto y = std::max(clip.y0, 0); y < std::min(clip.y1, fb.height); y++) {
+    fill_span(fb.pixels + static_cast<std::ptrdiff_t>(y) * fb.pitch + x0,
+              x1 - x0,
+              color);
+  }
+}
+
+void backend::Software_FillRect(Framebuffer& fb,
+                                const engine::Rect& r,
+                                const engine::Color& c,
+                                ClipRect clip)
+{
+  const auto cov = Software_Coverage(r);
+  fill_covered(fb,
+               {std::max({cov.x0, clip.x0, 0}),
+                std::max({cov.y0, clip.y0, 0}),
+                std::min({cov.x1, clip.x1, fb.width}),
+                std::min({cov.y1, clip.y1, fb.height})},
+               Software_PackColor(c));
+}
+
+void backend::Software_FillRects(Framebuffer& fb,
+                                 const engine::RectColumns& rects,
+                                 ClipRect clip)
+{
+  constexpr std::size_t block = 256;
+  std::array<int, block> x0 {}, y0 {}, x1 {}, y1 {};
+  std::array<std::uint32_t, block> px {};
+
+  const auto cx0 = std::max(clip.x0, 0);
+  const auto cy0 = std::max(clip.y0, 0);
+  const auto cx1 = std::min(clip.x1, fb.width);
+  const auto cy1 = std::min(clip.y1, fb.height);
+
+  for (std::size_t base = 0; base < rects.size(); base += block) {
+    const auto n = std::min(block, rects.size() - base);
+    const auto* x = rects.x.data() + base;
+    const auto* y = rects.y.data() + base;
+    const auto* w = rects.w.data() + base;
+    const auto* h = rects.h.data() + base;
+
+    // straight-line loops over the columns, vectorized by the compiler
+    for (std::size_t i = 0; i < n; i++) {
+      x0[i] = std::max(static_cast<int>(std::ceil(x[i] - 0.5F)), cx0);
+      y0[i] = std::max(static_cast<int>(std::ceil(y[i] - 0.5F)), cy0);
+      x1[i] = std::min(static_cast<int>(std::ceil(x[i] + w[i] - 0.5F)), cx1);
+      y1[i] = std::min(static_cast<int>(std::ceil(y[i] + h[i] - 0.5F)), cy1);
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      px[i] = std::bit_cast<std::uint32_t>(
+          std::array<std::uint8_t, 4> {to_u8(rects.r[base + i]),
+                                       to_u8(rects.g[base + i]),
+                                       to_u8(rects.b[base + i]),
+                                       to_u8(rects.a[base + i])});
+    }
+
+    for (std::size_t i = 0; i < n; i++) {
+      fill_covered(fb, {x0[i], y0[i], x1[i], y1[i]}, px[i]);
+    }
+  }
+}
+
+void backend::Software_Render(Framebuffer& fb,
+                              const engine::CommandBuffer& commands)
+{
+  const ClipRect clip {0, 0, fb.width, fb.height};
+  for (const auto& cmd : commands) {
+    switch (cmd.type) {
+      case engine::CommandType::Rectangle: {
+        const auto& rc = static_cast<const engine::RectCommand&>(cmd);
+        Software_FillRect(fb, rc.bbox, rc.c, clip);
+      } break;
+      case engine::CommandType::Text:
+        break;
+    }
+  }
+}
+
+void backend::Software_Render(Framebuffer& fb,
+                              const engine::CommandStore& commands)
+{
+  Software_FillRects(fb, commands.rects, {0, 0, fb.width, fb.height});
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
+#include <engine/command_store.hpp>
+
+namespace backend
+{
+// Caller-owned 32-bit framebuffer. Pixels are stored with bytes in R, G, B, A
+// memory order (SDL_PIXELFORMAT_RGBA32), pitch is measured in pixels.
+struct Framebuffer
+{
+  std::uint32_t* pixels;
+  int width;
+  int height;
+  int pitch;
+};
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct ClipRect
+{
+  int x0, y0, x1, y1;
+};
+
+auto Software_PackColor(const engine::Color& c) -> std::uint32_t;
+
+// Pixels whose centers lie inside r, unclipped
+auto Software_Coverage(const engine::Rect& r) -> ClipRect;
+
+void Software_Clear(Framebuffer& fb, std::uint32_t color);
+void Software_Clear(Framebuffer& fb, std::uint32_t color, ClipRect clip);
+
+void Software_FillRect(Framebuffer& fb,
+                       const engine::Rect& r,
+                       const engine::Color& c,
+                       ClipRect clip);
+
+// Rasterizes every command into fb. Text commands are left to the presenting
+// backend.
+void Software_Render(Framebuffer& fb, const engine::CommandBuffer& commands);
+
+// Fills a whole column store of rectangles. Coverage and colors are computed
+// for a block of rectangles at a time straight from the columns.
+void Software_FillRects(Framebuffer& fb,
+                        const engine::RectColumns& rects,
+                        ClipRect clip);
+
+void Software_Render(Framebuffer& fb, const engine::CommandStore& commands);
+}  // namespace backend
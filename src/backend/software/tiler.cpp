@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+
+#include <backend/software/tiler.hpp>
+
+using namespace backend;
+
+namespace
+{
+constexpr std::uint64_t hash_seed = 0xcbf29ce484222325ULL;
+constexpr std::uint64_t hash_mul = 0x9e3779b97f4a7c15ULL;
+
+auto mix(std::uint64_t h, std::uint64_t v) -> std::uint64_t
+{
+  h ^= v;
+  h *= hash_mul;
+  return h ^ (h >> 29);
+}
+
+auto hash_bytes(const std::byte* p, std::size_t n) -> std::uint64_t
+{
+  auto h = hash_seed;
+  for (; n >= sizeof(std::uint64_t); n -= sizeof(std::uint64_t)) {
+    std::uint64_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    h = mix(h, v);
+    p += sizeof(v);
+  }
+  if (n > 0) {
+    std::uint64_t v = 0;
+    std::memcpy(&v, p, n);
+    h = mix(h, v);
+  }
+  return h;
+}
+}  // namespace
+
+TileRenderer::TileRenderer(engine::ThreadPool& pool)
+    : _pool(pool)
+{
+}
+
+auto TileRenderer::tile_rect(int tile) const -> ClipRect
+{
+  const auto x0 = (tile % _tiles_x) * tile_size;
+  const auto y0 = (tile / _tiles_x) * tile_size;
+  return {x0,
+          y0,
+          std::min(x0 + tile_size, _width),
+          std::min(y0 + tile_size, _height)};
+}
+
+void TileRenderer::resize(const Framebuffer& fb)
+{
+  if (fb.width == _width && fb.height == _height) {
+    return;
+  }
+  _width = fb.width;
+  _height = fb.height;
+  _tiles_x = (_width + tile_size - 1) / tile_size;
+  _tiles_y = (_height + tile_size - 1) / tile_size;
+  _bins.resize(static_cast<std::size_t>(_tiles_x * _tiles_y));
+  _hashes.resize(_bins.size());
+  invalidate();
+}
+
+void TileRenderer::invalidate()
+{
+  // no command stream hashes to zero, see bin()
+  _prev_hashes.assign(_bins.size(), 0);
+}
+
+void TileRenderer::bin(const engine::CommandBuffer& commands,
+                       std::uint32_t clear)
+{
+  for (auto& b : _bins) {
+    b.clear();
+  }
+  std::fill(_hashes.begin(), _hashes.end(), mix(hash_seed, clear) | 1U);
+
+  for (const auto& cmd : commands) {
+    const auto cov = Software_Coverage(cmd.bbox);
+    const auto x0 = std::max(cov.x0, 0);
+    const auto y0 = std::max(cov.y0, 0);
+    const auto x1 = std::min(cov.x1, _width);
+    const auto y1 = std::min(cov.y1, _height);
+    if (x0 >= x1 || y0 >= y1) {
+      continue;
+    }
+    const auto h = hash_bytes(reinterpret_cast<const std::byte*>(&cmd),
+                              cmd.size);
+    for (auto ty = y0 / tile_size; ty <= (y1 - 1) / tile_size; ty++) {
+      for (auto tx = x0 / tile_size; tx <= (x1 - 1) / tile_size; tx++) {
+        const auto t = static_cast<std::size_t>(ty * _tiles_x + tx);
+        _bins[t].push_back(&cmd);
+        _hashes[t] = mix(_hashes[t], h) | 1U;
+      }
+    }
+  }
+}
+
+void TileRenderer::rasterize(Framebuffer& fb,
+                             std::uint32_t clear,
+                             int tile) const
+{
+  const auto clip = tile_rect(tile);
+  Software_Clear(fb, clear, clip);
+  for (const auto* cmd : _bins[static_cast<std::size_t>(tile)]) {
+    switch (cmd->type) {
+      case engine::CommandType::Rectangle: {
+        const auto* rc = static_cast<const engine::RectCommand*>(cmd);
+        Software_FillRect(fb, rc->bbox, rc->c, clip);
+      } break;
+      case engine::CommandType::Text:
+        break;
+    }
+  }
+}
+
+void TileRenderer::merge_dirty()
+{
+  // Runs of dirty tiles in a row become spans; a span identical to one in the
+  // row above extends that rectangle downwards instead of starting a new one.
+  _dirty.clear();
+  _open.clear();
+  auto to_pixels = [this](ClipRect r) -> ClipRect
+  {
+    return {r.x0 * tile_size,
+            r.y0 * tile_size,
+            std::min(r.x1 * tile_size, _width),
+            std::min(r.y1 * tile_size, _height)};
+  };
+
+  auto it = _dirty_tiles.begin();
+  for (auto ty = 0; ty < _tiles_y; ty++) {
+    _next_open.clear();
+    auto open = _open.begin();
+    while (it != _dirty_tiles.end() && *it / _tiles_x == ty) {
+      const auto x0 = *it % _tiles_x;
+      auto x1 = x0 + 1;
+      for (++it; x1 < _tiles_x && it != _dirty_tiles.end()
+           && *it == ty * _tiles_x + x1;
+           ++it)
+      {
+        x1++;
+      }
+
+      for (; open != _open.end() && open->x0 < x0; ++open) {
+        _dirty.push_back(to_pixels(*open));
+      }
+      if (open != _open.end() && open->x0 == x0 && open->x1 == x1) {
+        _next_open.push_back({x0, open->y0, x1, ty + 1});
+        ++open;
+      } else {
+        _next_open.push_back({x0, ty, x1, ty + 1});
+      }
+    }
+    for (; open != _open.end(); ++open) {
+      _dirty.push_back(to_pixels(*open));
+    }
+    std::swap(_open, _next_open);
+  }
+  for (const auto& r : _open) {
+    _dirty.push_back(to_pixels(r));
+  }
+}
+
+void TileRenderer::render(Framebuffer& fb,
+                          std::uint32_t clear,
+                          const engine::CommandBuffer& commands)
+{
+  resize(fb);
+  bin(commands, clear);
+
+  _dirty_tiles.clear();
+  for (auto t = 0UL; t < _hashes.size(); t++) {
+    if (_hashes[t] != _prev_hashes[t]) {
+      _dirty_tiles.push_back(static_cast<int>(t));
+    }
+  }
+  merge_dirty();
+  std::swap(_hashes, _prev_hashes);
+
+  _pool.parallel_for(_dirty_tiles.size(),
+                     1,
+                     [&](std::size_t first, std::size_t last, std::size_t)
+                     {
+                       for (auto i = first; i < last; i++) {
+                         rasterize(fb, clear, _dirty_tiles[i]);
+                       }
+                     });
+}
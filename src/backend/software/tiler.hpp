@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <backend/software/raster.hpp>
+#include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
+#include <engine/thread_pool.hpp>
+
+namespace backend
+{
+// Bins commands into fixed screen tiles and rasterizes the tiles in parallel.
+// Commands keep their submission order inside every tile, so the output is
+// identical to Software_Render.
+//
+// The framebuffer is retained between frames: every tile keeps a hash of the
+// commands that touched it and is only rasterized again when that hash
+// changes. dirty() lists the regions written by the last render(), with
+// adjacent dirty tiles merged into as few rectangles as possible.
+class TileRenderer
+{
+public:
+  static constexpr int tile_size = 64;
+
+  explicit TileRenderer(engine::ThreadPool& pool);
+
+  void render(Framebuffer& fb,
+              std::uint32_t clear,
+              const engine::CommandBuffer& commands);
+
+  int tiles_x() const { return _tiles_x; }
+  int tiles_y() const { return _tiles_y; }
+
+  auto tile_rect(int tile) const -> ClipRect;
+
+  const std::vector<ClipRect>& dirty() const { return _dirty; }
+
+  // Forces every tile to be redrawn on the next render()
+  void invalidate();
+
+protected:
+  TileRenderer(const TileRenderer&) = delete;
+  TileRenderer& operator=(const TileRenderer&) = delete;
+
+private:
+  void resize(const Framebuffer& fb);
+  void bin(const engine::CommandBuffer& commands, std::uint32_t clear);
+  void rasterize(Framebuffer& fb, std::uint32_t clear, int tile) const;
+  void merge_dirty();
+
+  engine::ThreadPool& _pool;
+  int _width {0};
+  int _height {0};
+  int _tiles_x {0};
+  int _tiles_y {0};
+  std::vector<std::vector<const engine::Command*>> _bins;
+  std::vector<std::uint64_t> _hashes;
+  std::vector<std::uint64_t> _prev_hashes;
+  std::vector<int> _dirty_tiles;
+  std::vector<ClipRect> _dirty;
+  std::vector<ClipRect> _open;
+  std::vector<ClipRect> _next_open;
+};
+}  // namespace backend
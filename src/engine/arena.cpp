@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstring>
+#include <utility>
 
 #include "arena.hpp"
 
@@ -6,27 +8,81 @@
 
 using namespace engine;
 
-Arena::Arena(std::byte* base, std::size_t size)
+Arena::Arena(std::byte* base,
+             std::size_t size,
+             std::pmr::memory_resource* upstream,
+             std::size_t chunk_size)
     : _base(base)
-    , _size(size)
+    , _size(static_cast<std::ptrdiff_t>(size))
     , _pos(0)
+    , _buffer(base)
+    , _buffer_size(static_cast<std::ptrdiff_t>(size))
+    , _upstream(upstream)
+    , _chunk_size(chunk_size)
+{
+}
+
+Arena::Arena(std::pmr::memory_resource* upstream, std::size_t chunk_size)
+    : Arena(nullptr, 0, upstream, chunk_size)
 {
 }
 
 Arena::Arena(Arena&& arena)
-    : _base(arena._base)
-    , _size(arena._size)
-    , _pos(arena._pos)
+    : _base(std::exchange(arena._base, nullptr))
+    , _size(std::exchange(arena._size, 0))
+    , _pos(std::exchange(arena._pos, 0))
+    , _buffer(std::exchange(arena._buffer, nullptr))
+    , _buffer_size(std::exchange(arena._buffer_size, 0))
+    , _upstream(arena._upstream)
+    , _chunk_size(arena._chunk_size)
+    , _chunks(std::exchange(arena._chunks, nullptr))
+    , _current(std::exchange(arena._current, nullptr))
+    , _used(std::exchange(arena._used, 0U))
+    , _last_frame(std::exchange(arena._last_frame, 0U))
+    , _peak(std::exchange(arena._peak, 0U))
+{
+}
+
+Arena::~Arena()
 {
-  arena._base = nullptr;
-  arena._size = 0u;
-  arena._pos = 0u;
+  while (_chunks != nullptr) {
+    auto* next = _chunks->next;
+    _upstream->deallocate(
+        _chunks, sizeof(Chunk) + _chunks->size, alignof(std::max_align_t));
+    _chunks = next;
+  }
 }
 
 void Arena::init() {}
 
 void Arena::reset()
 {
+  _last_frame = stats().used;
+  _peak = std::max(_peak, _last_frame);
+  _used = 0;
+  _current = nullptr;
+  use(_buffer, _buffer_size);
+}
+
+auto Arena::stats() const -> Stats
+{
+  Stats s {_used + static_cast<std::size_t>(_pos),
+           _last_frame,
+           0,
+           static_cast<std::size_t>(_buffer_size),
+           0};
+  s.peak = std::max(_peak, s.used);
+  for (auto* c = _chunks; c != nullptr; c = c->next) {
+    s.capacity += c->size;
+    s.chunks++;
+  }
+  return s;
+}
+
+void Arena::use(std::byte* base, std::ptrdiff_t size)
+{
+  _base = base;
+  _size = size;
   _pos = 0;
 }
 
@@ -38,16 +94,55 @@ void* Arena::aligned_alloc(std::ptrdiff_t size, std::ptrdiff_t align)
   auto beg = _base + _pos;
   auto end = _base + _size;
   auto padding = -(uintptr_t)beg & (align - 1);
-  auto avail = end - beg - padding;
-  if (avail < 0) {
-    // not enough memory
-    return nullptr;
+  auto avail = end - beg - static_cast<std::ptrdiff_t>(padding);
+  if (_base == nullptr || avail < size) {
+    return overflow(size, align);
   }
   void* p = beg + padding;
-  _pos += padding + size;
+  _pos += static_cast<std::ptrdiff_t>(padding) + size;
   return p;
 }
 
+void* Arena::overflow(std::ptrdiff_t size, std::ptrdiff_t align)
+{
+  if (_upstream == nullptr) {
+    // not enough memory
+    return nullptr;
+  }
+
+  // the tail of the block we leave counts as used for this frame
+  _used += static_cast<std::size_t>(_size);
+
+  // reuse chunks kept from earlier frames before asking upstream for more
+  auto* next = _current == nullptr ? _chunks : _current->next;
+  const auto need = static_cast<std::size_t>(size + align);
+  while (next != nullptr && next->size < need) {
+    _used += next->size;
+    _current = next;
+    next = next->next;
+  }
+
+  if (next == nullptr) {
+    const auto bytes = std::max(_chunk_size, need);
+    next = static_cast<Chunk*>(_upstream->allocate(
+        sizeof(Chunk) + bytes, alignof(std::max_align_t)));
+    next->next = nullptr;
+    next->size = bytes;
+    if (_current == nullptr) {
+      // chunks skipped above are all in front of _current, so this only
+      // happens with an empty chain
+      _chunks = next;
+    } else {
+      _current->next = next;
+    }
+  }
+
+  _current = next;
+  use(reinterpret_cast<std::byte*>(next + 1),
+      static_cast<std::ptrdiff_t>(next->size));
+  return aligned_alloc(size, align);
+}
+
 void* Arena::malloc(std::ptrdiff_t size)
 {
   return aligned_alloc(size, alignof(std::max_align_t));
@@ -57,7 +152,7 @@ void* Arena::calloc(std::ptrdiff_t size)
 {
   auto* p = Arena::malloc(size);
   if (p != nullptr) {
-    std::memset(p, 0, size);
+    std::memset(p, 0, static_cast<std::size_t>(size));
   }
   return p;
-}
\ No newline at end of file
+}
@@ -3,27 +3,51 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory_resource>
 
 namespace engine
 {
+// Bump allocator over a caller-provided buffer. When constructed with an
+// upstream resource the arena chains extra chunks from it instead of failing
+// once the buffer is full; chunks are kept across reset() so a steady-state
+// frame makes no allocations.
 class Arena
 {
 public:
-  Arena(std::byte* base, std::size_t size);
+  struct Stats
+  {
+    std::size_t used;  // bytes handed out since the last reset()
+    std::size_t last_frame;  // used at the last reset()
+    std::size_t peak;  // largest per-frame usage so far
+    std::size_t capacity;  // bytes in the buffer plus all chunks
+    std::size_t chunks;  // chunks taken from upstream
+  };
+
+  static constexpr std::size_t default_chunk_size = 1024UL * 1024UL;
+
+  Arena(std::byte* base,
+        std::size_t size,
+        std::pmr::memory_resource* upstream = nullptr,
+        std::size_t chunk_size = default_chunk_size);
+  explicit Arena(std::pmr::memory_resource* upstream,
+                 std::size_t chunk_size = default_chunk_size);
   Arena(Arena&& arena);
   template<typename T, std::size_t S>
   Arena(std::array<T, S>& arr)
-      : Arena(arr.data(), sizeof(arr))
+      : Arena(reinterpret_cast<std::byte*>(arr.data()), sizeof(arr))
   {
   }
+  ~Arena();
 
   void init();
   void reset();
 
+  Stats stats() const;
+
   template<typename T>
   inline T* aligned_alloc(std::ptrdiff_t align = alignof(T))
   {
-    return aligned_alloc(sizeof(T), align);
+    return static_cast<T*>(aligned_alloc(sizeof(T), align));
   }
 
   void* aligned_alloc(std::ptrdiff_t size, std::ptrdiff_t align);
@@ -49,8 +73,29 @@ protected:
   Arena& operator=(const Arena&) = delete;
 
 private:
+  struct Chunk
+  {
+    Chunk* next;
+    std::size_t size;
+  };
+
+  void* overflow(std::ptrdiff_t size, std::ptrdiff_t align);
+  void use(std::byte* base, std::ptrdiff_t size);
+
   std::byte* _base;
   std::ptrdiff_t _size;
   std::ptrdiff_t _pos;
+
+  std::byte* _buffer;
+  std::ptrdiff_t _buffer_size;
+
+  std::pmr::memory_resource* _upstream;
+  std::size_t _chunk_size;
+  Chunk* _chunks {nullptr};
+  Chunk* _current {nullptr};
+
+  std::size_t _used {0};
+  std::size_t _last_frame {0};
+  std::size_t _peak {0};
 };
-}  // namespace engine
\ No newline at end of file
+}  // namespace engine
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <new>
 
 #include <engine/vec.hpp>
 
@@ -35,20 +37,40 @@ struct Command
   Rect bbox;
 };
 
+// Every record starts at, and its size is a multiple of, this alignment, so
+// records appended back to back stay contiguous.
+inline constexpr std::size_t command_align = 8;
+
+constexpr auto command_size(std::size_t bytes) -> std::size_t
+{
+  return (bytes + command_align - 1) & ~(command_align - 1);
+}
+
 struct RectCommand : public Command
 {
   Color c;
 
+  static constexpr auto record_size() -> std::size_t
+  {
+    return command_size(sizeof(RectCommand));
+  }
+
+  static auto emplace(void* dst, Rect r, Color c) -> RectCommand*
+  {
+    return new (dst) RectCommand {{.type = CommandType::Rectangle,
+                                   .size = record_size(),
+                                   .bbox = r},
+                                  c};
+  }
+
   static auto push(Rect r, Color c, char* buf, std::size_t idx) -> std::size_t
   {
-    new (&buf[idx]) RectCommand {{.type = CommandType::Rectangle,
-                                  .size = sizeof(RectCommand),
-                                  .bbox = r},
-                                 c};
-    return idx + sizeof(RectCommand);
+    return idx + emplace(&buf[idx], r, c)->size;
   }
 };
 
+// Variable-length record: text holds nchar characters followed by a NUL, and
+// size covers all of them.
 struct TextCommand : public Command
 {
   int font;
@@ -56,22 +78,43 @@ struct TextCommand : public Command
   std::size_t nchar;
   char text[1];
 
+  static constexpr auto record_size(std::size_t nchar) -> std::size_t
+  {
+    return command_size(sizeof(TextCommand) + nchar);
+  }
+
+  static auto emplace(void* dst,
+                      Point p,
+                      int font,
+                      Color c,
+                      const char* text,
+                      std::size_t nchar) -> TextCommand*
+  {
+    auto* tc = new (dst) TextCommand {
+        {.type = CommandType::Text,
+         .size = static_cast<uint32_t>(record_size(nchar)),
+         .bbox = {p.x(), p.y(), 0, 0}},
+        font,
+        c,
+        nchar,
+        {}};
+    std::memcpy(tc->text, text, nchar);
+    tc->text[nchar] = '\0';
+    return tc;
+  }
+
   static auto push(Point p,
-                          int font,
-                          Color c,
-                          const char* text,
-                          std::size_t nchar,
-                          char* buf,
-                          std::size_t idx) -> std::size_t
+                   int font,
+                   Color c,
+                   const char* text,
+                   std::size_t nchar,
+                   char* buf,
+                   std::size_t idx) -> std::size_t
   {
-    auto* rc = new (&buf[idx]) TextCommand {{.type = CommandType::Text,
-                                  .size = sizeof(TextCommand),
-                                  .bbox = {p.x(), p.y(), 0, 0}},
-                                 font,
-                                 c,
-                                 nchar};
-    strncpy(rc->text, text, nchar);
-    return idx + sizeof(TextCommand);
+    return idx + emplace(&buf[idx], p, font, c, text, nchar)->size;
   }
 };
+
+static_assert(alignof(RectCommand) <= command_align);
+static_assert(alignof(TextCommand) <= command_align);
 }  // namespace engine
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include <engine/command_buffer.hpp>
+
+using namespace engine;
+
+CommandBuffer::CommandBuffer(Arena& arena)
+    : _arena(arena)
+{
+}
+
+void CommandBuffer::clear()
+{
+  _arena.reset();
+  _segments.clear();
+  _count = 0;
+}
+
+void* CommandBuffer::append(std::size_t size)
+{
+  auto* p = static_cast<std::byte*>(
+      _arena.aligned_alloc(static_cast<std::ptrdiff_t>(size),
+                           static_cast<std::ptrdiff_t>(command_align)));
+  if (p == nullptr) {
+    return nullptr;
+  }
+  if (_segments.empty() || _segments.back().end != p) {
+    _segments.push_back({p, p});
+  }
+  _segments.back().end = p + size;
+  _count++;
+  return p;
+}
+
+RectCommand* CommandBuffer::push_rect(Rect r, Color c)
+{
+  auto* p = append(RectCommand::record_size());
+  return p == nullptr ? nullptr : RectCommand::emplace(p, r, c);
+}
+
+TextCommand* CommandBuffer::push_text(Point p,
+                                      int font,
+                                      Color c,
+                                      std::string_view text)
+{
+  auto* dst = append(TextCommand::record_size(text.size()));
+  return dst == nullptr
+      ? nullptr
+      : TextCommand::emplace(dst, p, font, c, text.data(), text.size());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include <engine/arena.hpp>
+#include <engine/command.hpp>
+
+namespace engine
+{
+// Append-only stream of variable-length command records allocated from an
+// arena that is dedicated to the buffer. Records are laid out back to back;
+// when a growable arena moves on to a new chunk the buffer starts a new
+// segment, which the iterator steps over transparently.
+class CommandBuffer
+{
+  struct Segment
+  {
+    std::byte* begin;
+    std::byte* end;
+  };
+
+public:
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Command;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Command*;
+    using reference = const Command&;
+
+    const_iterator() = default;
+
+    reference operator*() const { return *operator->(); }
+    pointer operator->() const
+    {
+      return std::launder(reinterpret_cast<const Command*>(_p));
+    }
+
+    const_iterator& operator++()
+    {
+      _p += operator->()->size;
+      if (_p == _seg->end) {
+        ++_seg;
+        _p = _seg == _last ? nullptr : _seg->begin;
+      }
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+      return _p == other._p;
+    }
+
+  private:
+    friend class CommandBuffer;
+
+    const_iterator(const Segment* seg, const Segment* last)
+        : _seg(seg)
+        , _last(last)
+        , _p(seg == last ? nullptr : seg->begin)
+    {
+    }
+
+    const Segment* _seg {nullptr};
+    const Segment* _last {nullptr};
+    const std::byte* _p {nullptr};
+  };
+
+  explicit CommandBuffer(Arena& arena);
+
+  // Drops every command and resets the arena
+  void clear();
+
+  // Return nullptr when the arena is out of memory
+  RectCommand* push_rect(Rect r, Color c);
+  TextCommand* push_text(Point p, int font, Color c, std::string_view text);
+
+  std::size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+
+  const_iterator begin() const
+  {
+    return {_segments.data(), _segments.data() + _segments.size()};
+  }
+  const_iterator end() const { return {}; }
+
+protected:
+  CommandBuffer(const CommandBuffer&) = delete;
+  CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+private:
+  void* append(std::size_t size);
+
+  Arena& _arena;
+  std::vector<Segment> _segments;
+  std::size_t _count {0};
+};
+}  // namespace engine
@@ -0,0 +1,72 @@
+#include <engine/command_store.hpp>
+
+using namespace engine;
+
+void RectColumns::clear()
+{
+  for (auto* col : {&x, &y, &w, &h, &r, &g, &b, &a}) {
+    col->clear();
+  }
+}
+
+void RectColumns::push(Rect bbox, Color c)
+{
+  x.push_back(bbox.x());
+  y.push_back(bbox.y());
+  w.push_back(bbox.z());
+  h.push_back(bbox.w());
+  r.push_back(c.x());
+  g.push_back(c.y());
+  b.push_back(c.z());
+  a.push_back(c.w());
+}
+
+void TextColumns::clear()
+{
+  for (auto* col : {&x, &y, &r, &g, &b, &a}) {
+    col->clear();
+  }
+  font.clear();
+  offset.clear();
+  length.clear();
+  chars.clear();
+}
+
+void TextColumns::push(Point p, int f, Color c, std::string_view text)
+{
+  x.push_back(p.x());
+  y.push_back(p.y());
+  font.push_back(f);
+  r.push_back(c.x());
+  g.push_back(c.y());
+  b.push_back(c.z());
+  a.push_back(c.w());
+  offset.push_back(static_cast<std::uint32_t>(chars.size()));
+  length.push_back(static_cast<std::uint32_t>(text.size()));
+  chars.append(text);
+}
+
+void CommandStore::clear()
+{
+  rects.clear();
+  texts.clear();
+}
+
+void CommandStore::append(const CommandBuffer& commands)
+{
+  for (const auto& cmd : commands) {
+    switch (cmd.type) {
+      case CommandType::Rectangle: {
+        const auto& rc = static_cast<const RectCommand&>(cmd);
+        rects.push(rc.bbox, rc.c);
+      } break;
+      case CommandType::Text: {
+        const auto& tc = static_cast<const TextCommand&>(cmd);
+        texts.push({tc.bbox.x(), tc.bbox.y()},
+                   tc.font,
+                   tc.c,
+                   {tc.text, tc.nchar});
+      } break;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
+
+namespace engine
+{
+// One contiguous column per field, index i across all columns is one command.
+struct RectColumns
+{
+  std::vector<float> x, y, w, h;
+  std::vector<float> r, g, b, a;
+
+  std::size_t size() const { return x.size(); }
+  void clear();
+  void push(Rect bbox, Color c);
+};
+
+struct TextColumns
+{
+  std::vector<float> x, y;
+  std::vector<int> font;
+  std::vector<float> r, g, b, a;
+  std::vector<std::uint32_t> offset, length;
+  std::string chars;
+
+  std::size_t size() const { return x.size(); }
+  void clear();
+  void push(Point p, int font, Color c, std::string_view text);
+  std::string_view text(std::size_t i) const
+  {
+    return {chars.data() + offset[i], length[i]};
+  }
+};
+
+// Structure-of-arrays alternative to CommandBuffer for batch consumers that
+// process thousands of commands of one type at once. Order is only kept
+// within a type: rectangles are drawn before text. Streams that interleave
+// types in a meaningful order should stay in a CommandBuffer.
+class CommandStore
+{
+public:
+  void clear();
+
+  void push_rect(Rect r, Color c) { rects.push(r, c); }
+  void push_text(Point p, int font, Color c, std::string_view text)
+  {
+    texts.push(p, font, c, text);
+  }
+
+  // Appends every command of an interleaved buffer
+  void append(const CommandBuffer& commands);
+
+  RectColumns rects;
+  TextColumns texts;
+};
+}  // namespace engine
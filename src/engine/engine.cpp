@@ -6,6 +6,7 @@ using namespace engine;
 
 Engine::Engine(Arena& arena, Dimensions viewbox)
     : _arena(std::move(arena))
+    , _commands(_arena)
     , _viewbox(viewbox)
 
 {
@@ -22,4 +23,12 @@ void Engine::begin(Dimensions viewbox)
   begin();
 }
 
-void Engine::begin() {}
\ No newline at end of file
+void Engine::begin()
+{
+  _commands.clear();
+}
+
+const CommandBuffer& Engine::end()
+{
+  return _commands;
+}
\ No newline at end of file
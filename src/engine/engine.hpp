@@ -5,6 +5,7 @@
 
 #include <engine/arena.hpp>
 #include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
 #include <engine/vec.hpp>
 
 namespace engine
@@ -19,7 +20,10 @@ public:
   void set_viewbox(Dimensions dims);
   void begin(Dimensions dims);
   void begin();
-  // CommandArray end();
+  const CommandBuffer& end();
+
+  CommandBuffer& commands() { return _commands; }
+  Dimensions viewbox() const { return _viewbox; }
 
 protected:
   Engine(const Engine&) = delete;
@@ -27,6 +31,7 @@ protected:
 
 private:
   Arena _arena;
+  CommandBuffer _commands;
   Dimensions _viewbox;
 };
 }  // namespace engine
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <engine/font.hpp>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace engine;
+
+namespace
+{
+// FreeType sizes fonts in 1/64 pt, closer sizes rasterize the same
+constexpr float size_resolution = 1.0F / 64.0F;
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path)
+{
+#if defined(_WIN32)
+  auto* file = CreateFileA(path.c_str(),
+                           GENERIC_READ,
+                           FILE_SHARE_READ,
+                           nullptr,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr) {
+      _data = static_cast<const std::byte*>(
+          MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+      _size = static_cast<std::size_t>(size.QuadPart);
+    }
+  }
+  CloseHandle(file);
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    auto* p = mmap(nullptr,
+                   static_cast<std::size_t>(st.st_size),
+                   PROT_READ,
+                   MAP_PRIVATE,
+                   fd,
+                   0);
+    if (p != MAP_FAILED) {
+      _data = static_cast<const std::byte*>(p);
+      _size = static_cast<std::size_t>(st.st_size);
+    }
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+#endif
+  if (_data == nullptr) {
+    _size = 0;
+  }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : _data(std::exchange(other._data, nullptr))
+    , _size(std::exchange(other._size, 0U))
+#if defined(_WIN32)
+    , _mapping(std::exchange(other._mapping, nullptr))
+#endif
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    unmap();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0U);
+#if defined(_WIN32)
+    _mapping = std::exchange(other._mapping, nullptr);
+#endif
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile()
+{
+  unmap();
+}
+
+void MappedFile::unmap()
+{
+#if defined(_WIN32)
+  if (_data != nullptr) {
+    UnmapViewOfFile(_data);
+  }
+  if (_mapping != nullptr) {
+    CloseHandle(_mapping);
+  }
+  _mapping = nullptr;
+#else
+  if (_data != nullptr) {
+    munmap(const_cast<std::byte*>(_data), _size);
+  }
+#endif
+  _data = nullptr;
+  _size = 0;
+}
+
+int FontRegistry::add(const std::string& path, float size)
+{
+  auto file = static_cast<std::size_t>(
+      std::find(_paths.begin(), _paths.end(), path) - _paths.begin());
+  if (file == _paths.size()) {
+    MappedFile mapped(path);
+    if (!mapped.valid()) {
+      return -1;
+    }
+    _paths.push_back(path);
+    _files.push_back(std::move(mapped));
+  }
+
+  for (auto i = 0UL; i < _fonts.size(); i++) {
+    if (_fonts[i].file == file
+        && std::abs(_fonts[i].size - size) < size_resolution)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  _fonts.push_back({file, size, {0, 0, 0}});
+  return static_cast<int>(_fonts.size() - 1);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& path);
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  const std::byte* data() const { return _data; }
+  std::size_t size() const { return _size; }
+  bool valid() const { return _data != nullptr; }
+
+protected:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+  void unmap();
+
+  const std::byte* _data {nullptr};
+  std::size_t _size {0};
+#if defined(_WIN32)
+  void* _mapping {nullptr};
+#endif
+};
+
+struct FontMetrics
+{
+  int ascent;
+  int descent;
+  int height;
+};
+
+// Fonts referenced by TextCommand::font. Every file is memory-mapped once and
+// shared by all the sizes registered from it; a backend opens one handle per
+// id from the mapped bytes and reports the metrics back.
+class FontRegistry
+{
+public:
+  struct Font
+  {
+    std::size_t file;
+    float size;
+    FontMetrics metrics;
+  };
+
+  // Returns the id to put in TextCommand::font, or -1 when the file cannot
+  // be mapped. Registering the same path and size twice returns the same id.
+  int add(const std::string& path, float size);
+
+  std::size_t size() const { return _fonts.size(); }
+  const Font& font(int id) const
+  {
+    return _fonts[static_cast<std::size_t>(id)];
+  }
+  const MappedFile& file(int id) const { return _files[font(id).file]; }
+
+  const FontMetrics& metrics(int id) const { return font(id).metrics; }
+  void set_metrics(int id, const FontMetrics& metrics)
+  {
+    _fonts[static_cast<std::size_t>(id)].metrics = metrics;
+  }
+
+private:
+  std::vector<std::string> _paths;
+  std::vector<MappedFile> _files;
+  std::vector<Font> _fonts;
+};
+}  // namespace engine
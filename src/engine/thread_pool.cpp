@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include <engine/thread_pool.hpp>
+
+using namespace engine;
+
+namespace
+{
+constexpr auto pack(std::uint64_t begin, std::uint64_t end) -> std::uint64_t
+{
+  return (end << 32) | begin;
+}
+
+constexpr auto range_begin(std::uint64_t r) -> std::size_t
+{
+  return static_cast<std::size_t>(r & 0xffffffffU);
+}
+
+constexpr auto range_end(std::uint64_t r) -> std::size_t
+{
+  return static_cast<std::size_t>(r >> 32);
+}
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t nthreads)
+{
+  nthreads = std::max<std::size_t>(nthreads, 1);
+  _shares = std::make_unique<Share[]>(nthreads);
+  _workers.reserve(nthreads - 1);
+  for (auto i = 1UL; i < nthreads; i++) {
+    _workers.emplace_back([this, i] { work(i); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& t : _workers) {
+    t.join();
+  }
+}
+
+void ThreadPool::parallel_for(std::size_t count,
+                              std::size_t grain,
+                              const Task& fn)
+{
+  if (count == 0) {
+    return;
+  }
+  grain = std::max<std::size_t>(grain, 1);
+  if (_workers.empty() || count <= grain) {
+    fn(0, count, 0);
+    return;
+  }
+  // chunk indices have to fit the packed ranges
+  grain = std::max(grain, count / 0xffffffffU + 1);
+
+  {
+    std::lock_guard lock(_mutex);
+    _task = &fn;
+    _count = count;
+    _grain = grain;
+    const auto chunks = (count + grain - 1) / grain;
+    const auto n = size();
+    for (auto w = 0UL; w < n; w++) {
+      _shares[w].range.store(pack(w * chunks / n, (w + 1) * chunks / n),
+                             std::memory_order_relaxed);
+    }
+    _active = _workers.size();
+    _generation++;
+  }
+  _wake.notify_all();
+
+  run_chunks(0);
+
+  std::unique_lock lock(_mutex);
+  _done.wait(lock, [this] { return _active == 0; });
+  _task = nullptr;
+}
+
+void ThreadPool::run(std::size_t chunk, std::size_t worker)
+{
+  const auto begin = chunk * _grain;
+  (*_task)(begin, std::min(begin + _grain, _count), worker);
+}
+
+bool ThreadPool::pop(std::size_t worker, std::size_t& chunk)
+{
+  auto& range = _shares[worker].range;
+  auto r = range.load(std::memory_order_acquire);
+  for (;;) {
+    const auto b = range_begin(r);
+    const auto e = range_end(r);
+    if (b >= e) {
+      return false;
+    }
+    if (range.compare_exchange_weak(
+            r, pack(b + 1, e), std::memory_order_acq_rel))
+    {
+      chunk = b;
+      return true;
+    }
+  }
+}
+
+bool ThreadPool::steal(std::size_t worker, std::size_t& chunk)
+{
+  const auto n = size();
+  for (;;) {
+    // pick the victim with the most work left
+    std::size_t victim = n;
+    std::uint64_t r = 0;
+    std::size_t most = 0;
+    for (auto k = 1UL; k < n; k++) {
+      const auto v = (worker + k) % n;
+      const auto rv = _shares[v].range.load(std::memory_order_acquire);
+      const auto left = range_end(rv) > range_begin(rv)
+          ? range_end(rv) - range_begin(rv)
+          : 0;
+      if (left > most) {
+        victim = v;
+        r = rv;
+        most = left;
+      }
+    }
+    if (victim == n) {
+      return false;
+    }
+
+    const auto b = range_begin(r);
+    const auto e = range_end(r);
+    const auto mid = b + (e - b) / 2;
+    if (_shares[victim].range.compare_exchange_strong(
+            r, pack(b, mid), std::memory_order_acq_rel))
+    {
+      // our own share is empty, so nobody else is touching it
+      _shares[worker].range.store(pack(mid + 1, e), std::memory_order_release);
+      chunk = mid;
+      return true;
+    }
+  }
+}
+
+void ThreadPool::run_chunks(std::size_t worker)
+{
+  std::size_t chunk = 0;
+  while (pop(worker, chunk) || steal(worker, chunk)) {
+    run(chunk, worker);
+  }
+}
+
+void ThreadPool::work(std::size_t worker)
+{
+  std::size_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock lock(_mutex);
+      _wake.wait(lock, [&] { return _stop || _generation != seen; });
+      if (_stop) {
+        return;
+      }
+      seen = _generation;
+    }
+
+    run_chunks(worker);
+
+    std::lock_guard lock(_mutex);
+    if (--_active == 0) {
+      _done.notify_one();
+    }
+  }
+}
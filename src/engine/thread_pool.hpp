@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine
+{
+// Fork-join pool. A job is split into chunks and every worker starts on its
+// own contiguous share of them; a worker that runs out steals the upper half
+// of the largest share it finds, so uneven chunks still balance out.
+class ThreadPool
+{
+public:
+  // fn(begin, end, worker) where worker is in [0, size())
+  using Task = std::function<void(std::size_t, std::size_t, std::size_t)>;
+
+  // nthreads counts the calling thread, which takes part in every job
+  explicit ThreadPool(
+      std::size_t nthreads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  std::size_t size() const { return _workers.size() + 1; }
+
+  // Splits [0, count) into chunks of at most grain items and blocks until
+  // every chunk has run.
+  void parallel_for(std::size_t count, std::size_t grain, const Task& fn);
+
+protected:
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+  // chunk range [begin, end) packed as end << 32 | begin so both ends move
+  // with one compare-and-swap
+  struct alignas(64) Share
+  {
+    std::atomic<std::uint64_t> range {0};
+  };
+
+  void work(std::size_t worker);
+  void run_chunks(std::size_t worker);
+  bool pop(std::size_t worker, std::size_t& chunk);
+  bool steal(std::size_t worker, std::size_t& chunk);
+  void run(std::size_t chunk, std::size_t worker);
+
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  std::size_t _generation {0};
+  std::size_t _active {0};
+  bool _stop {false};
+
+  const Task* _task {nullptr};
+  std::size_t _count {0};
+  std::size_t _grain {1};
+  std::unique_ptr<Share[]> _shares;
+};
+}  // namespace engine
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace engine
+{
+// Single-producer single-consumer handoff of the latest value. The writer
+// fills write_buffer() and publish()es it; the reader calls update() and then
+// reads read_buffer(), which is always the newest complete value. Neither
+// side ever waits for the other: the third buffer is the one in between.
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T& init)
+      : _buffers {init, init, init}
+  {
+  }
+
+  // writer side
+
+  T& write_buffer() { return _buffers[_write]; }
+
+  // Hands write_buffer() over to the reader and takes the spare buffer
+  void publish()
+  {
+    const auto next = static_cast<std::uint8_t>(_write | fresh);
+    const auto prev = _middle.exchange(next, std::memory_order_acq_rel);
+    _write = static_cast<std::uint8_t>(prev & index_mask);
+  }
+
+  // reader side
+
+  // Takes the latest published buffer, if there is one the reader has not
+  // seen yet. Returns whether read_buffer() changed.
+  bool update()
+  {
+    if ((_middle.load(std::memory_order_relaxed) & fresh) == 0) {
+      return false;
+    }
+    const auto prev = _middle.exchange(_read, std::memory_order_acq_rel);
+    _read = static_cast<std::uint8_t>(prev & index_mask);
+    return true;
+  }
+
+  const T& read_buffer() const { return _buffers[_read]; }
+
+protected:
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+private:
+  // _middle holds the index of the spare buffer, with fresh set while it
+  // holds a value the reader has not taken yet
+  static constexpr std::uint8_t index_mask = 3;
+  static constexpr std::uint8_t fresh = 4;
+
+  std::array<T, 3> _buffers {};
+  alignas(64) std::atomic<std::uint8_t> _middle {1};
+  alignas(64) std::uint8_t _write {0};
+  alignas(64) std::uint8_t _read {2};
+};
+}  // namespace engine
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace sim
+{
+// Tracks which blocks of size x size cells of a grid hold fluid. A block is
+// active when it or one of the 8 blocks around it was marked, so the active
+// blocks also cover every face and neighbour of a fluid cell and every cell a
+// particle can reach in a step. The grids themselves stay dense: passes only
+// visit the active blocks, and the cells of inactive ones are left at their
+// background values. Blocks and cells are stored column by column.
+class ActiveBlocks
+{
+public:
+  static constexpr int size = 8;
+
+  // Starts out with every block active, so the first pass visits them all
+  void init(int numCellsX, int numCellsY)
+  {
+    cellsX = numCellsX;
+    cellsY = numCellsY;
+    numX = (cellsX + size - 1) / size;
+    numY = (cellsY + size - 1) / size;
+    const auto blocks = static_cast<std::size_t>(numX * numY);
+    marked.assign(blocks, 0);
+    active.assign(blocks, 1);
+    touched.assign(blocks, 1);
+    rowBegin.assign(static_cast<std::size_t>(cellsX), 0);
+    rowEnd.assign(static_cast<std::size_t>(cellsX), 0);
+    rebuild();
+  }
+
+  // Marks the block of cell (i, j); safe to call from several threads
+  void mark(int i, int j)
+  {
+    std::atomic_ref<char> flag(marked[block(i / size, j / size)]);
+    flag.store(1, std::memory_order_relaxed);
+  }
+
+  // Makes the blocks marked since the last update() and their neighbours the
+  // active set, and lists the blocks that dropped out of it in released
+  void update()
+  {
+    released.clear();
+    for (auto bx = 0; bx < numX; bx++) {
+      for (auto by = 0; by < numY; by++) {
+        bool near = false;
+        for (auto x = std::max(bx - 1, 0); x <= std::min(bx + 1, numX - 1);
+             x++)
+        {
+          for (auto y = std::max(by - 1, 0); y <= std::min(by + 1, numY - 1);
+               y++)
+          {
+            near = near || marked[block(x, y)] != 0;
+          }
+        }
+        const auto b = block(bx, by);
+        if (active[b] != 0 && !near) {
+          released.push_back(static_cast<int>(b));
+        }
+        active[b] = near ? 1 : 0;
+        touched[b] = touched[b] != 0 || near ? 1 : 0;
+      }
+    }
+    std::fill(marked.begin(), marked.end(), 0);
+    rebuild();
+  }
+
+  // Blocks active since the last clearTouched(), for passes that run less
+  // often than update() and have to clean up after released blocks too
+  std::vector<int> touchedBlocks() const
+  {
+    std::vector<int> out;
+    for (auto b = 0UL; b < touched.size(); b++) {
+      if (touched[b] != 0) {
+        out.push_back(static_cast<int>(b));
+      }
+    }
+    return out;
+  }
+
+  void clearTouched() { touched = active; }
+
+  // Has the next touchedBlocks() include the block of cell (i, j), for cells
+  // changed from outside the active blocks
+  void touch(int i, int j) { touched[block(i / size, j / size)] = 1; }
+
+  // cells [x0, x1) x [y0, y1) of block b
+  int x0(int b) const { return (b / numY) * size; }
+  int x1(int b) const { return std::min(x0(b) + size, cellsX); }
+  int y0(int b) const { return (b % numY) * size; }
+  int y1(int b) const { return std::min(y0(b) + size, cellsY); }
+
+  // active blocks in ascending order
+  std::vector<int> list;
+  // blocks the last update() deactivated
+  std::vector<int> released;
+  // rows [rowBegin[i], rowEnd[i]) of cell column i span its active blocks
+  std::vector<int> rowBegin, rowEnd;
+  // cells [boundsX0, boundsX1) x [boundsY0, boundsY1) span all active blocks
+  int boundsX0 {0}, boundsX1 {0};
+  int boundsY0 {0}, boundsY1 {0};
+
+private:
+  std::size_t block(int bx, int by) const
+  {
+    return static_cast<std::size_t>(bx * numY + by);
+  }
+
+  void rebuild()
+  {
+    list.clear();
+    std::fill(rowBegin.begin(), rowBegin.end(), 0);
+    std::fill(rowEnd.begin(), rowEnd.end(), 0);
+    boundsX0 = cellsX;
+    boundsY0 = cellsY;
+    boundsX1 = 0;
+    boundsY1 = 0;
+
+    for (auto bx = 0; bx < numX; bx++) {
+      int first = numY;
+      int last = -1;
+      for (auto by = 0; by < numY; by++) {
+        if (active[block(bx, by)] != 0) {
+          list.push_back(static_cast<int>(block(bx, by)));
+          first = std::min(first, by);
+          last = by;
+        }
+      }
+      if (last < 0) {
+        continue;
+      }
+      const auto b0 = static_cast<int>(block(bx, first));
+      const auto b1 = static_cast<int>(block(bx, last));
+      for (auto i = x0(b0); i < x1(b0); i++) {
+        rowBegin[static_cast<std::size_t>(i)] = y0(b0);
+        rowEnd[static_cast<std::size_t>(i)] = y1(b1);
+      }
+      boundsX0 = std::min(boundsX0, x0(b0));
+      boundsX1 = std::max(boundsX1, x1(b0));
+      boundsY0 = std::min(boundsY0, y0(b0));
+      boundsY1 = std::max(boundsY1, y1(b1));
+    }
+  }
+
+  int cellsX {0}, cellsY {0};
+  int numX {0}, numY {0};
+  std::vector<char> marked;
+  std::vector<char> active;
+  std::vector<char> touched;
+};
+}  // namespace sim
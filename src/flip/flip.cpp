@@ -0,0 +1,671 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <flip/kernels.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define RENDER_FLIP_AVX2 1
+#  define RENDER_TARGET_AVX2 __attribute__((target("avx2")))
+#  define RENDER_TARGET_AVX512 __attribute__((target("avx512f")))
+// lets one kernel template be compiled under each of the targets above
+#  define RENDER_INLINE_KERNEL inline __attribute__((always_inline))
+#endif
+
+namespace
+{
+// Pressure p of one cell before it is applied; false, with p and div 0, when
+// the cell does not update. Mirrors FlipFluid::relaxCell so the vector path
+// matches the scalar one.
+template<typename T>
+auto cell_pressure(const sim::PressureSweep<T>& sw,
+                   std::size_t c,
+                   T& p,
+                   T& div) -> bool
+{
+  const auto n = sw.n;
+  p = T(0);
+  div = T(0);
+  if (sw.type[c] != sim::FLUID) {
+    return false;
+  }
+  const auto s = sw.s[c - n] + sw.s[c + n] + sw.s[c - 1] + sw.s[c + 1];
+  if (std::abs(s) < std::numeric_limits<T>::min()) {
+    return false;
+  }
+  div = sw.u[c + n] - sw.u[c] + sw.v[c + 1] - sw.v[c];
+  const auto compression = sw.density[c] - sw.restDensity;
+  if (compression > T(0)) {
+    div = div - compression;
+  }
+  p = -div / s * sw.overRelaxation;
+  return true;
+}
+
+#if defined(RENDER_FLIP_AVX2)
+
+// One AVX2 register of doubles
+struct F64x4
+{
+  using T = double;
+  using V = __m256d;
+  using M = V;
+  static constexpr std::size_t lanes = 4;
+
+  RENDER_TARGET_AVX2 static V load(const T* p) { return _mm256_loadu_pd(p); }
+  RENDER_TARGET_AVX2 static void store(T* p, V a) { _mm256_storeu_pd(p, a); }
+  RENDER_TARGET_AVX2 static V set1(T a) { return _mm256_set1_pd(a); }
+  RENDER_TARGET_AVX2 static V add(V a, V b) { return _mm256_add_pd(a, b); }
+  RENDER_TARGET_AVX2 static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+  RENDER_TARGET_AVX2 static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+  RENDER_TARGET_AVX2 static V div(V a, V b) { return _mm256_div_pd(a, b); }
+  RENDER_TARGET_AVX2 static V max(V a, V b) { return _mm256_max_pd(a, b); }
+  RENDER_TARGET_AVX2 static V bit_and(V a, V b) { return _mm256_and_pd(a, b); }
+
+  // b where mask is set, a elsewhere
+  RENDER_TARGET_AVX2 static V select(V a, V b, V mask)
+  {
+    return _mm256_blendv_pd(a, b, mask);
+  }
+  RENDER_TARGET_AVX2 static V less(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+  }
+  RENDER_TARGET_AVX2 static V greater(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+  }
+  RENDER_TARGET_AVX2 static V greater_equal(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_GE_OQ);
+  }
+  RENDER_TARGET_AVX2 static V not_equal(V a, V b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ);
+  }
+  RENDER_TARGET_AVX2 static V abs_mask()
+  {
+    return _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  }
+  // lanes j, j + 1, ... alternate colors, starting with the color of j
+  RENDER_TARGET_AVX2 static V even_lanes()
+  {
+    return _mm256_castsi256_pd(_mm256_setr_epi64x(-1, 0, -1, 0));
+  }
+  RENDER_TARGET_AVX2 static V odd_lanes()
+  {
+    return _mm256_castsi256_pd(_mm256_setr_epi64x(0, -1, 0, -1));
+  }
+  RENDER_TARGET_AVX2 static V fluid(const sim::CellType* type)
+  {
+    return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(
+        _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(type)),
+                        _mm_set1_epi32(sim::FLUID))));
+  }
+  RENDER_TARGET_AVX2 static V mask_load(const T* p, V mask)
+  {
+    return _mm256_maskload_pd(p, _mm256_castpd_si256(mask));
+  }
+  RENDER_TARGET_AVX2 static void mask_store(T* p, V mask, V a)
+  {
+    _mm256_maskstore_pd(p, _mm256_castpd_si256(mask), a);
+  }
+  RENDER_TARGET_AVX2 static T hmax(V a)
+  {
+    alignas(32) T out[lanes];
+    _mm256_store_pd(out, a);
+    return *std::max_element(out, out + lanes);
+  }
+};
+
+// One AVX2 register of floats, twice the cells of F64x4
+struct F32x8
+{
+  using T = float;
+  using V = __m256;
+  using M = V;
+  static constexpr std::size_t lanes = 8;
+
+  RENDER_TARGET_AVX2 static V load(const T* p) { return _mm256_loadu_ps(p); }
+  RENDER_TARGET_AVX2 static void store(T* p, V a) { _mm256_storeu_ps(p, a); }
+  RENDER_TARGET_AVX2 static V set1(T a) { return _mm256_set1_ps(a); }
+  RENDER_TARGET_AVX2 static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  RENDER_TARGET_AVX2 static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  RENDER_TARGET_AVX2 static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  RENDER_TARGET_AVX2 static V div(V a, V b) { return _mm256_div_ps(a, b); }
+  RENDER_TARGET_AVX2 static V max(V a, V b) { return _mm256_max_ps(a, b); }
+  RENDER_TARGET_AVX2 static V bit_and(V a, V b) { return _mm256_and_ps(a, b); }
+
+  RENDER_TARGET_AVX2 static V select(V a, V b, V mask)
+  {
+    return _mm256_blendv_ps(a, b, mask);
+  }
+  RENDER_TARGET_AVX2 static V less(V a, V b)
+  {
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+  }
+  RENDER_TARGET_AVX2 static V greater(V a, V b)
+  {
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+  }
+  RENDER_TARGET_AVX2 static V greater_equal(V a, V b)
+  {
+    return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+  }
+  RENDER_TARGET_AVX2 static V not_equal(V a, V b)
+  {
+    return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+  }
+  RENDER_TARGET_AVX2 static V abs_mask()
+  {
+    return _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  }
+  RENDER_TARGET_AVX2 static V even_lanes()
+  {
+    return _mm256_castsi256_ps(_mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0));
+  }
+  RENDER_TARGET_AVX2 static V odd_lanes()
+  {
+    return _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+  }
+  RENDER_TARGET_AVX2 static V fluid(const sim::CellType* type)
+  {
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(type)),
+        _mm256_set1_epi32(sim::FLUID)));
+  }
+  RENDER_TARGET_AVX2 static V mask_load(const T* p, V mask)
+  {
+    return _mm256_maskload_ps(p, _mm256_castps_si256(mask));
+  }
+  RENDER_TARGET_AVX2 static void mask_store(T* p, V mask, V a)
+  {
+    _mm256_maskstore_ps(p, _mm256_castps_si256(mask), a);
+  }
+  RENDER_TARGET_AVX2 static T hmax(V a)
+  {
+    alignas(32) T out[lanes];
+    _mm256_store_ps(out, a);
+    return *std::max_element(out, out + lanes);
+  }
+};
+
+// One AVX-512 register of doubles. Only what the particle kernels use;
+// comparisons give a bit mask instead of a lane mask.
+struct F64x8
+{
+  using T = double;
+  using V = __m512d;
+  using M = __mmask8;
+  static constexpr std::size_t lanes = 8;
+
+  RENDER_TARGET_AVX512 static V load(const T* p) { return _mm512_loadu_pd(p); }
+  RENDER_TARGET_AVX512 static void store(T* p, V a) { _mm512_storeu_pd(p, a); }
+  RENDER_TARGET_AVX512 static V set1(T a) { return _mm512_set1_pd(a); }
+  RENDER_TARGET_AVX512 static V add(V a, V b) { return _mm512_add_pd(a, b); }
+  RENDER_TARGET_AVX512 static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+  // the rounding-mode form is opaque to the compiler, so it never fuses a
+  // product and a sum into an FMA that would round unlike the scalar loop
+  RENDER_TARGET_AVX512 static V mul(V a, V b)
+  {
+    return _mm512_maskz_mul_round_pd(
+        static_cast<M>(-1), a, b, _MM_FROUND_CUR_DIRECTION);
+  }
+  RENDER_TARGET_AVX512 static V select(V a, V b, M mask)
+  {
+    return _mm512_mask_blend_pd(mask, a, b);
+  }
+  RENDER_TARGET_AVX512 static M less(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+  }
+  RENDER_TARGET_AVX512 static M greater(V a, V b)
+  {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+  }
+};
+
+// One AVX-512 register of floats
+struct F32x16
+{
+  using T = float;
+  using V = __m512;
+  using M = __mmask16;
+  static constexpr std::size_t lanes = 16;
+
+  RENDER_TARGET_AVX512 static V load(const T* p) { return _mm512_loadu_ps(p); }
+  RENDER_TARGET_AVX512 static void store(T* p, V a) { _mm512_storeu_ps(p, a); }
+  RENDER_TARGET_AVX512 static V set1(T a) { return _mm512_set1_ps(a); }
+  RENDER_TARGET_AVX512 static V add(V a, V b) { return _mm512_add_ps(a, b); }
+  RENDER_TARGET_AVX512 static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+  RENDER_TARGET_AVX512 static V mul(V a, V b)
+  {
+    return _mm512_maskz_mul_round_ps(
+        static_cast<M>(-1), a, b, _MM_FROUND_CUR_DIRECTION);
+  }
+  RENDER_TARGET_AVX512 static V select(V a, V b, M mask)
+  {
+    return _mm512_mask_blend_ps(mask, a, b);
+  }
+  RENDER_TARGET_AVX512 static M less(V a, V b)
+  {
+    return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+  }
+  RENDER_TARGET_AVX512 static M greater(V a, V b)
+  {
+    return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+  }
+};
+
+// The particle kernels step whole registers in the order of the scalar loops
+// in FlipFluid, so they round the same way. They are only ever inlined into
+// the target wrappers below, so GCC's note about passing vectors without the
+// matching target enabled does not apply to them.
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+template<typename L, typename T = typename L::T>
+RENDER_INLINE_KERNEL auto integrate_particles(sim::ParticleColumns<T>& pa,
+                                              std::size_t begin,
+                                              std::size_t end,
+                                              T dt,
+                                              T gravity) -> std::size_t
+{
+  auto* x = pa.x.data();
+  auto* y = pa.y.data();
+  auto* vx = pa.vx.data();
+  auto* vy = pa.vy.data();
+  const auto step = L::set1(dt);
+  const auto dv = L::set1(dt * gravity);
+
+  auto i = begin;
+  for (; i + L::lanes <= end; i += L::lanes) {
+    const auto v = L::add(L::load(vy + i), dv);
+    L::store(vy + i, v);
+    L::store(x + i, L::add(L::load(x + i), L::mul(L::load(vx + i), step)));
+    L::store(y + i, L::add(L::load(y + i), L::mul(v, step)));
+  }
+  return i;
+}
+
+template<typename L, typename T = typename L::T>
+RENDER_INLINE_KERNEL auto collide_particles(
+    sim::ParticleColumns<T>& pa,
+    std::size_t begin,
+    std::size_t end,
+    const sim::ParticleCollision<T>& c) -> std::size_t
+{
+  auto* px = pa.x.data();
+  auto* py = pa.y.data();
+  auto* pvx = pa.vx.data();
+  auto* pvy = pa.vy.data();
+  const auto zero = L::set1(T(0));
+  const auto min_x = L::set1(c.minX);
+  const auto max_x = L::set1(c.maxX);
+  const auto min_y = L::set1(c.minY);
+  const auto max_y = L::set1(c.maxY);
+
+  auto i = begin;
+  for (; i + L::lanes <= end; i += L::lanes) {
+    auto x = L::load(px + i);
+    auto y = L::load(py + i);
+    auto vx = L::load(pvx + i);
+    auto vy = L::load(pvy + i);
+
+    auto wall = L::less(x, min_x);
+    x = L::select(x, min_x, wall);
+    vx = L::select(vx, zero, wall);
+    wall = L::greater(x, max_x);
+    x = L::select(x, max_x, wall);
+    vx = L::select(vx, zero, wall);
+    wall = L::less(y, min_y);
+    y = L::select(y, min_y, wall);
+    vy = L::select(vy, zero, wall);
+    wall = L::greater(y, max_y);
+    y = L::select(y, max_y, wall);
+    vy = L::select(vy, zero, wall);
+
+    L::store(px + i, x);
+    L::store(py + i, y);
+    L::store(pvx + i, vx);
+    L::store(pvy + i, vy);
+  }
+  return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic pop
+#endif
+
+// Instantiates the kernels under the target of their lane type
+template<typename L, typename T = typename L::T>
+RENDER_TARGET_AVX2 auto integrate_avx2(sim::ParticleColumns<T>& pa,
+                                       std::size_t begin,
+                                       std::size_t end,
+                                       T dt,
+                                       T gravity) -> std::size_t
+{
+  return integrate_particles<L>(pa, begin, end, dt, gravity);
+}
+
+template<typename L, typename T = typename L::T>
+RENDER_TARGET_AVX512 auto integrate_avx512(sim::ParticleColumns<T>& pa,
+                                           std::size_t begin,
+                                           std::size_t end,
+                                           T dt,
+                                           T gravity) -> std::size_t
+{
+  return integrate_particles<L>(pa, begin, end, dt, gravity);
+}
+
+template<typename L, typename T = typename L::T>
+RENDER_TARGET_AVX2 auto collide_avx2(sim::ParticleColumns<T>& pa,
+                                     std::size_t begin,
+                                     std::size_t end,
+                                     const sim::ParticleCollision<T>& c)
+    -> std::size_t
+{
+  return collide_particles<L>(pa, begin, end, c);
+}
+
+template<typename L, typename T = typename L::T>
+RENDER_TARGET_AVX512 auto collide_avx512(sim::ParticleColumns<T>& pa,
+                                         std::size_t begin,
+                                         std::size_t end,
+                                         const sim::ParticleCollision<T>& c)
+    -> std::size_t
+{
+  return collide_particles<L>(pa, begin, end, c);
+}
+
+template<typename L, typename T = typename L::T>
+RENDER_TARGET_AVX2 auto sweep_pressure(const sim::PressureSweep<T>& sw,
+                                       int color,
+                                       std::size_t i0,
+                                       std::size_t i1) -> T
+{
+  constexpr auto w = L::lanes;
+  const auto n = sw.n;
+  if (n < 3) {
+    return T(0);
+  }
+  // pressures of the current column, padded with a zero on both ends
+  thread_local std::vector<T> column;
+  column.assign(n, T(0));
+  auto* pc = column.data();
+
+  const auto zero = L::set1(T(0));
+  const auto omega = L::set1(sw.overRelaxation);
+  const auto rest = L::set1(sw.restDensity);
+  const auto cp = L::set1(sw.cp);
+  const auto min_s = L::set1(std::numeric_limits<T>::min());
+  const auto abs_mask = L::abs_mask();
+  const auto lanes_even = L::even_lanes();
+  const auto lanes_odd = L::odd_lanes();
+  auto max_div = zero;
+  T max_tail = 0;
+
+  for (auto i = i0; i < i1; i++) {
+    std::size_t jb = 1;
+    std::size_t je = n - 1;
+    if (sw.rowBegin != nullptr) {
+      jb = std::max<std::size_t>(jb, static_cast<std::size_t>(sw.rowBegin[i]));
+      je = std::min<std::size_t>(je, static_cast<std::size_t>(sw.rowEnd[i]));
+    }
+    if (jb >= je) {
+      continue;
+    }
+
+    const auto col = i * n;
+    auto* u = sw.u + col;
+    auto* v = sw.v + col;
+    auto* p = sw.p + col;
+    const auto* s = sw.s + col;
+
+    // The u faces left of the first column and right of the last one are
+    // shared with the neighbouring ranges, whose workers may be storing the
+    // lanes of the other color right now, so those are only loaded and
+    // stored through this color's lanes.
+    const bool shared_left = i == i0;
+    const bool shared_right = i + 1 == i1;
+
+    // every pressure of the column first, none of them shares a face
+    std::size_t j = jb;
+    for (; j + w <= je; j += w) {
+      const auto parity = ((i + j) & 1U) == static_cast<std::size_t>(color)
+          ? lanes_even
+          : lanes_odd;
+      const auto sx0 = L::load(s + j - n);
+      const auto sx1 = L::load(s + j + n);
+      const auto sy0 = L::load(s + j - 1);
+      const auto sy1 = L::load(s + j + 1);
+      const auto ssum = L::add(L::add(L::add(sx0, sx1), sy0), sy1);
+
+      const auto u0 =
+          shared_left ? L::mask_load(u + j, parity) : L::load(u + j);
+      const auto u1 =
+          shared_right ? L::mask_load(u + j + n, parity) : L::load(u + j + n);
+      const auto du = L::sub(u1, u0);
+      auto div = L::sub(L::add(du, L::load(v + j + 1)), L::load(v + j));
+      const auto compression = L::sub(L::load(sw.density + col + j), rest);
+      div = L::select(
+          div, L::sub(div, compression), L::greater(compression, zero));
+      const auto pv = L::mul(L::div(L::sub(zero, div), ssum), omega);
+
+      const auto solid_free =
+          L::greater_equal(L::bit_and(ssum, abs_mask), min_s);
+      const auto mask = L::bit_and(
+          L::bit_and(L::fluid(sw.type + col + j), solid_free), parity);
+      L::store(pc + j, L::select(zero, pv, mask));
+      max_div = L::max(max_div, L::bit_and(L::bit_and(div, abs_mask), mask));
+    }
+    // the rows past the last whole register, which the loop applying the
+    // pressures below ends with as well
+    const auto tail = j;
+    std::array<bool, w> updated {};
+    for (; j < je; j++) {
+      T div = 0;
+      pc[j] = T(0);
+      if (((i + j) & 1U) == static_cast<std::size_t>(color)) {
+        updated[j - tail] = cell_pressure(sw, col + j, pc[j], div);
+        max_tail = std::max(max_tail, std::abs(div));
+      }
+    }
+
+    // then apply them, through the lanes of the cells that were updated
+    j = jb;
+    for (; j + w <= je; j += w) {
+      const auto pj = L::load(pc + j);
+      const auto mask = L::not_equal(pj, zero);
+
+      L::store(p + j, L::add(L::load(p + j), L::mul(cp, pj)));
+      const auto u0 = shared_left ? L::mask_load(u + j, mask) : L::load(u + j);
+      const auto u1 =
+          shared_right ? L::mask_load(u + j + n, mask) : L::load(u + j + n);
+      L::mask_store(u + j, mask, L::sub(u0, L::mul(L::load(s + j - n), pj)));
+      L::mask_store(
+          u + j + n, mask, L::add(u1, L::mul(L::load(s + j + n), pj)));
+      L::store(v + j,
+               L::add(L::sub(L::load(v + j), L::mul(L::load(s + j - 1), pj)),
+                      L::mul(L::load(s + j), L::load(pc + j - 1))));
+    }
+    for (; j < je; j++) {
+      const auto pj = pc[j];
+      if (updated[j - tail]) {
+        p[j] += sw.cp * pj;
+        u[j] -= s[j - n] * pj;
+        u[j + n] += s[j + n] * pj;
+        v[j] -= s[j - 1] * pj;
+      }
+      v[j] += s[j] * pc[j - 1];
+    }
+    v[je] += s[je] * pc[je - 1];
+    // pc[jb - 1] has to read zero for the next column
+    std::fill(pc + jb, pc + je, T(0));
+  }
+
+  return std::max(max_tail, L::hmax(max_div));
+}
+
+#endif
+}  // namespace
+
+#if defined(RENDER_FLIP_AVX2)
+
+bool sim::hasAVX2()
+{
+  static const bool supported = __builtin_cpu_supports("avx2") != 0;
+  return supported;
+}
+
+bool sim::hasAVX512()
+{
+  static const bool supported = __builtin_cpu_supports("avx512f") != 0;
+  return supported;
+}
+
+auto sim::sweepPressureAVX2(const PressureSweep<double>& sw,
+                            int color,
+                            std::size_t i0,
+                            std::size_t i1) -> double
+{
+  return sweep_pressure<F64x4>(sw, color, i0, i1);
+}
+
+auto sim::sweepPressureAVX2(const PressureSweep<float>& sw,
+                            int color,
+                            std::size_t i0,
+                            std::size_t i1) -> float
+{
+  return sweep_pressure<F32x8>(sw, color, i0, i1);
+}
+
+auto sim::integrateParticlesSIMD(ParticleColumns<double>& particles,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 double dt,
+                                 double gravity) -> std::size_t
+{
+  if (hasAVX512()) {
+    return integrate_avx512<F64x8>(particles, begin, end, dt, gravity);
+  }
+  if (hasAVX2()) {
+    return integrate_avx2<F64x4>(particles, begin, end, dt, gravity);
+  }
+  return begin;
+}
+
+auto sim::integrateParticlesSIMD(ParticleColumns<float>& particles,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 float dt,
+                                 float gravity) -> std::size_t
+{
+  if (hasAVX512()) {
+    return integrate_avx512<F32x16>(particles, begin, end, dt, gravity);
+  }
+  if (hasAVX2()) {
+    return integrate_avx2<F32x8>(particles, begin, end, dt, gravity);
+  }
+  return begin;
+}
+
+auto sim::collideParticlesSIMD(ParticleColumns<double>& particles,
+                               std::size_t begin,
+                               std::size_t end,
+                               const ParticleCollision<double>& collision)
+    -> std::size_t
+{
+  if (hasAVX512()) {
+    return collide_avx512<F64x8>(particles, begin, end, collision);
+  }
+  if (hasAVX2()) {
+    return collide_avx2<F64x4>(particles, begin, end, collision);
+  }
+  return begin;
+}
+
+auto sim::collideParticlesSIMD(ParticleColumns<float>& particles,
+                               std::size_t begin,
+                               std::size_t end,
+                               const ParticleCollision<float>& collision)
+    -> std::size_t
+{
+  if (hasAVX512()) {
+    return collide_avx512<F32x16>(particles, begin, end, collision);
+  }
+  if (hasAVX2()) {
+    return collide_avx2<F32x8>(particles, begin, end, collision);
+  }
+  return begin;
+}
+
+#else
+
+bool sim::hasAVX2()
+{
+  return false;
+}
+
+bool sim::hasAVX512()
+{
+  return false;
+}
+
+auto sim::sweepPressureAVX2(const PressureSweep<double>&,
+                            int,
+                            std::size_t,
+                            std::size_t) -> double
+{
+  return 0.0;
+}
+
+auto sim::sweepPressureAVX2(const PressureSweep<float>&,
+                            int,
+                            std::size_t,
+                            std::size_t) -> float
+{
+  return 0.0F;
+}
+
+auto sim::integrateParticlesSIMD(ParticleColumns<double>&,
+                                 std::size_t begin,
+                                 std::size_t,
+                                 double,
+                                 double) -> std::size_t
+{
+  return begin;
+}
+
+auto sim::integrateParticlesSIMD(ParticleColumns<float>&,
+                                 std::size_t begin,
+                                 std::size_t,
+                                 float,
+                                 float) -> std::size_t
+{
+  return begin;
+}
+
+auto sim::collideParticlesSIMD(ParticleColumns<double>&,
+                               std::size_t begin,
+                               std::size_t,
+                               const ParticleCollision<double>&) -> std::size_t
+{
+  return begin;
+}
+
+auto sim::collideParticlesSIMD(ParticleColumns<float>&,
+                               std::size_t begin,
+                               std::size_t,
+                               const ParticleCollision<float>&) -> std::size_t
+{
+  return begin;
+}
+
+#endif
@@ -1,665 +1,1234 @@
 #pragma once
 
-#include <cfloat>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <engine/thread_pool.hpp>
+#include <flip/active_blocks.hpp>
+#include <flip/kernels.hpp>
+#include <flip/mgpcg.hpp>
+#include <flip/obstacles.hpp>
+#include <flip/particles.hpp>
+#include <flip/spatial_grid.hpp>
+
 namespace sim
 {
+// T is the scalar of every particle and grid field: float for throughput,
+// double to validate against. Grid sizes and cell indices are ints.
+template<typename T = double>
 class FlipFluid
 {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>,
+                "FlipFluid has pressure kernels for float and double only");
+
 public:
-  enum CellType
+  using Scalar = T;
+  using CellType = sim::CellType;
+
+  enum PressureSolver
   {
-    FLUID,
-    AIR,
-    SOLID
+    // lexicographic SOR, each cell sees the updates of the previous one
+    GAUSS_SEIDEL,
+    // SOR over the two checkerboard colors in turn; every color sweep runs
+    // in parallel on the pool and with AVX2 where available
+    RED_BLACK,
+    // multigrid-preconditioned conjugate gradient, runs until the largest
+    // remaining divergence is below pressureTolerance
+    MGPCG
   };
 
   struct Color
   {
-    double r, g, b;
+    T r, g, b;
   };
 
   struct Cell
   {
-    double u, v, prev_u, prev_v;
-    double du, dv;
-    double p, s;
+    T u, v, prev_u, prev_v;
+    T du, dv;
+    T p, s;
     Color color;
     CellType type;
   };
 
-  struct Particle
-  {
-    double x, y;
-  };
-
   struct Scene
   {
-    double gravity {-9.81};
-    double dt {1.0 / 120.0};
-    double flipRatio {0.95f};
+    T gravity {T(-9.81)};
+    T dt {T(1.0 / 120.0)};
+    T flipRatio {T(0.95f)};
     int numPressureIters {100};
     int numParticleIters {2};
     int frameNr {0};
-    double overRelaxation {1.9};
+    T overRelaxation {T(1.9)};
     bool compensateDraft {true};
     bool separateParticles {true};
-    double obstacleX {0.0};
-    double obstacleY {0.0};
-    double obstacleRadius {0.15f};
+    T obstacleX {0};
+    T obstacleY {0};
+    T obstacleRadius {T(0.15f)};
     bool paused {true};
     bool showObstacle {true};
-    double obstacleVelX {0.0};
-    double obstacleVelY {0.0};
+    T obstacleVelX {0};
+    T obstacleVelY {0};
     bool showParticles {true};
     bool showGrid {false};
+    PressureSolver pressureSolver {GAUSS_SEIDEL};
+    // Pressure solves stop at a max divergence of pressureTolerance, or once
+    // a SOR sweep meets at most pressureReduction times the first sweep's
+    T pressureTolerance {T(1e-3)};
+    T pressureReduction {T(0.05)};
+    // The particle arrays are reordered by cell every this many steps so the
+    // particle loops walk the grid in order; 0 keeps the initial order.
+    int reorderInterval {16};
+    // Makes runs bitwise reproducible whatever the thread count: particles
+    // scatter to the grid by colored blocks (see scatterBlocks()) and the
+    // particle separation always takes the colored column order
+    bool deterministic {false};
+    // Each frame is split into as many substeps as it takes for no particle,
+    // nor the obstacle, to move more than cfl cells in one, up to
+    // maxSubSteps
+    T cfl {T(3)};
+    int maxSubSteps {4};
   };
 
-  void init_fluid(double density,
-                  double width,
-                  double height,
-                  double spacing,
-                  double particleRadius,
-                  double maxParticles)
+  // How the pressure solves went: one solve's while it runs, and after
+  // simulate() the whole frame's, iterations summed over the substeps and
+  // the largest residual of any of them
+  struct PressureStats
+  {
+    int iterations;
+    // largest divergence left in a fluid cell, max |b - Ax| for MGPCG
+    double residual;
+  };
+
+  void init_fluid(T density,
+                  T width,
+                  T height,
+                  T spacing,
+                  T particleRadius,
+                  int maxParticles)
   {
     // fluid
 
     this->density = density;
-    this->fNumX = std::floor(width / spacing) + 1.0;
-    this->fNumY = std::floor(height / spacing) + 1.0;
-    this->h = std::max(width / this->fNumX, height / this->fNumY);
-    this->fInvSpacing = 1.0 / this->h;
+    this->fNumX = static_cast<int>(std::floor(width / spacing)) + 1;
+    this->fNumY = static_cast<int>(std::floor(height / spacing)) + 1;
+    this->h = std::max(width / T(this->fNumX), height / T(this->fNumY));
+    this->fInvSpacing = T(1) / this->h;
     this->fNumCells = this->fNumX * this->fNumY;
 
-    this->u = std::vector<double>(this->fNumCells, 0.0);
-    this->v = std::vector<double>(this->fNumCells, 0.0);
-    this->du = std::vector<double>(this->fNumCells, 0.0);
-    this->dv = std::vector<double>(this->fNumCells, 0.0);
-    this->prevU = std::vector<double>(this->fNumCells, 0.0);
-    this->prevV = std::vector<double>(this->fNumCells, 0.0);
-    this->p = std::vector<double>(this->fNumCells, 0.0);
-    this->s = std::vector<double>(this->fNumCells, 0.0);
-    this->cellType = std::vector<CellType>(this->fNumCells, CellType::FLUID);
-    this->cellColor = std::vector<Color>(this->fNumCells, Color {});
+    const auto cells = static_cast<std::size_t>(this->fNumCells);
+    this->u = std::vector<T>(cells, T(0));
+    this->v = std::vector<T>(cells, T(0));
+    this->du = std::vector<T>(cells, T(0));
+    this->dv = std::vector<T>(cells, T(0));
+    this->prevU = std::vector<T>(cells, T(0));
+    this->prevV = std::vector<T>(cells, T(0));
+    this->p = std::vector<T>(cells, T(0));
+    this->s = std::vector<T>(cells, T(0));
+    this->cellType = std::vector<CellType>(cells, CellType::FLUID);
+    this->cellColor = std::vector<Color>(cells, Color {});
+    this->activeBlocks.init(fNumX, fNumY);
+    this->obstacles.init(fNumX, fNumY, h);
 
     // paraticles
 
     this->maxParticles = maxParticles;
 
-    this->particlePos = std::vector<Particle>(maxParticles, Particle {0, 0});
-    this->particleColor = std::vector<Color>(maxParticles, Color {0, 0, 1.0});
+    const auto count = static_cast<std::size_t>(maxParticles);
+    this->particles.resize(count);
+    this->particleColor = std::vector<Color>(count, Color {0, 0, T(1)});
 
-    this->particleVel = std::vector<double>(2 * maxParticles, 0.0);
-    this->particleDensity = std::vector<double>(fNumCells, 0.0);
-    this->particleRestDensity = 0.0;
+    this->particleDensity = std::vector<T>(cells, T(0));
+    this->particleRestDensity = 0;
 
     this->particleRadius = particleRadius;
-    this->pInvSpacing = 1.0 / (2.2 * particleRadius);
-    this->pNumX = std::floor(width * pInvSpacing) + 1.0;
-    this->pNumY = std::floor(height * pInvSpacing) + 1.0;
-    this->pNumCells = pNumX * pNumY;
+    this->particleGrid.init(width, height, T(2.2) * particleRadius, count);
+    this->scatterGrid.init(T(fNumX - 1) * h,
+                           T(fNumY - 1) * h,
+                           T(scatterBlock) * h,
+                           count);
 
-    this->numCellParticles = std::vector<int>(pNumCells, 0);
-    this->firstCellParticle = std::vector<int>(pNumCells + 1, 0);
-    this->cellParticleIds = std::vector<int>(maxParticles);
+    this->sortedParticles.resize(count);
+    this->sortedColor = std::vector<Color>(count);
+    buildCellOrder();
 
     this->numParticles = 0;
   }
 
-  void setObstacle(double x, double y, bool reset)
+  // Lists the particle grid cells in Z-order
+  void buildCellOrder()
+  {
+    const auto& grid = particleGrid;
+    std::vector<std::pair<std::uint64_t, int>> codes;
+    codes.reserve(static_cast<std::size_t>(grid.numCells));
+    for (auto xi = 0; xi < grid.numX; xi++) {
+      for (auto yi = 0; yi < grid.numY; yi++) {
+        codes.emplace_back(mortonCode(static_cast<std::uint32_t>(xi),
+                                      static_cast<std::uint32_t>(yi)),
+                           xi * grid.numY + yi);
+      }
+    }
+    std::sort(codes.begin(), codes.end());
+
+    cellOrder.resize(codes.size());
+    for (auto r = 0UL; r < codes.size(); r++) {
+      cellOrder[r] = codes[r].second;
+    }
+  }
+
+  // Sorts the particles, colors included, by the Z-order of their cell.
+  // Particles close in space end up close in memory, so the neighbour search
+  // and the grid transfers stream through the columns.
+  void reorderParticles()
+  {
+    binParticles();
+
+    auto dst = 0UL;
+    for (const auto cell : cellOrder) {
+      for (const auto id : particleGrid.particlesIn(cell)) {
+        const auto i = static_cast<std::size_t>(id);
+        sortedParticles.x[dst] = particles.x[i];
+        sortedParticles.y[dst] = particles.y[i];
+        sortedParticles.vx[dst] = particles.vx[i];
+        sortedParticles.vy[dst] = particles.vy[i];
+        sortedColor[dst] = particleColor[i];
+        dst++;
+      }
+    }
+    std::swap(particles, sortedParticles);
+    std::swap(particleColor, sortedColor);
+  }
+
+  void setObstacle(T x, T y, bool reset)
   {
-    double vx = 0.0;
-    double vy = 0.0;
+    T vx = 0;
+    T vy = 0;
 
     if (!reset) {
       vx = (x - scene.obstacleX) / scene.dt;
       vy = (y - scene.obstacleY) / scene.dt;
     }
 
+    // simulate() moves the scene obstacle here and rasterizes it
     scene.obstacleX = x;
     scene.obstacleY = y;
 
-    const double r = scene.obstacleRadius;
-    const int n = fNumY;
-    const double cd = std::sqrt(2.0) * this->h;
-
-    // for (auto i = 1u; i < fNumX - 2; i++) {
-    //   for (auto j = 1u; j < fNumY - 2; j++) {
-    //     this->s[i * n + j] = 1.0;
-    //     double dx = (i + 0.5f) * this->h - x;
-    //     double dy = (j + 0.5f) * this->h - y;
-
-    //     if (dx * dx + dy * dy < r * r) {
-    //       this->s[i * n + j] = 0.0;
-    //       this->u[i * n + j] = vx;
-    //       this->u[(i + 1) * n + j] = vx;
-    //       this->v[i * n + j] = vy;
-    //       this->v[i * n + j + 1] = vy;
-    //     }
-    //   }
-    // }
-
     scene.showObstacle = true;
     scene.obstacleVelX = vx;
     scene.obstacleVelY = vy;
   }
 
-  void integrateParticles(double dt, double gravity)
+  // Runs the particle and grid loops of simulate() on workers, nullptr goes
+  // back to running everything on the calling thread
+  void setThreadPool(engine::ThreadPool* workers) { pool = workers; }
+
+  template<typename Fn>
+  void parallelFor(std::size_t count, std::size_t grain, Fn&& fn)
   {
-    for (auto i = 0UL; i < numParticles; i++) {
-      particleVel[(2 * i) + 1] += dt * gravity;
-      auto& ppos = particlePos[i];
-      ppos.x += particleVel[2 * i] * dt;
-      ppos.y += particleVel[(2 * i) + 1] * dt;
+    if (pool == nullptr) {
+      fn(std::size_t {0}, count, std::size_t {0});
+    } else {
+      pool->parallel_for(count, grain, fn);
     }
   }
 
-  void pushParticlesApart(int numIters)
+  // Particle-to-grid scatter into `fields` grids. fn(acc, i) adds the
+  // contributions of particle i into acc[0..fields) and marks the cell of
+  // the particle in activeBlocks, which is updated once all particles are
+  // in. Serially acc is out itself; on a pool every worker adds into its own
+  // copy and the active blocks of the copies are summed into out afterwards,
+  // so no cell is written by two threads. A deterministic scene goes through
+  // scatterBlocks() instead.
+  template<typename Fn>
+  void scatter(std::size_t fields, T* const* out, Fn&& fn)
   {
-    double colorDiffusionCoeff = 0.001f;
-
-    std::fill(numCellParticles.begin(), numCellParticles.end(), 0);
-
-    for (auto i = 0; i < numParticles; i++) {
-      auto& ppos = particlePos[i];
-      const double x = ppos.x;
-      const double y = ppos.y;
-
-      double xi = std::clamp(std::floor(x * pInvSpacing), 0.0, pNumX - 1.0);
-      double yi = std::clamp(std::floor(y * pInvSpacing), 0.0, pNumY - 1.0);
-      double cellNr = xi * pNumY + yi;
-      numCellParticles[(int)cellNr]++;
+    const auto count = static_cast<std::size_t>(numParticles);
+    if (scene.deterministic) {
+      scatterBlocks(out, fn);
+      activeBlocks.update();
+      return;
+    }
+    if (pool == nullptr) {
+      for (auto i = 0UL; i < count; i++) {
+        fn(out, i);
+      }
+      activeBlocks.update();
+      return;
     }
 
-    int first = 0;
-
-    for (auto i = 0; i < pNumCells; i++) {
-      first += numCellParticles[i];
-      firstCellParticle[i] = first;
+    const auto cells = static_cast<std::size_t>(fNumCells);
+    const auto workers = pool->size();
+    // stays all zero between scatters
+    if (workerAccum.size() < workers * fields * cells) {
+      workerAccum.resize(workers * fields * cells, T(0));
     }
-    firstCellParticle[(std::size_t)pNumCells] = first;
+    auto* base = workerAccum.data();
+
+    pool->parallel_for(
+        count,
+        particleGrain,
+        [&](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+          std::array<T*, maxScatterFields> acc {};
+          for (auto f = 0UL; f < fields; f++) {
+            acc[f] = base + (worker * fields + f) * cells;
+          }
+          for (auto i = begin; i < end; i++) {
+            fn(acc.data(), i);
+          }
+        });
+
+    activeBlocks.update();
+    forBlockCells(activeBlocks.list,
+                  [&](std::size_t begin, std::size_t end)
+                  {
+                    for (auto f = 0UL; f < fields; f++) {
+                      for (auto w = 0UL; w < workers; w++) {
+                        auto* acc = base + (w * fields + f) * cells;
+                        for (auto i = begin; i < end; i++) {
+                          out[f][i] += acc[i];
+                          acc[i] = T(0);
+                        }
+                      }
+                    }
+                  });
+  }
 
-    for (auto i = 0; i < numParticles; i++) {
-      auto& ppos = particlePos[i];
-      const double x = ppos.x;
-      const double y = ppos.y;
+  // fn(begin, end) for the cells [begin, end) of every column of the given
+  // blocks, the blocks split between the workers
+  template<typename Fn>
+  void forBlockCells(const std::vector<int>& blocks, Fn&& fn)
+  {
+    const auto n = fNumY;
+    parallelFor(blocks.size(),
+                blockGrain,
+                [&](std::size_t begin, std::size_t end, std::size_t)
+                {
+                  for (auto k = begin; k < end; k++) {
+                    const auto b = blocks[k];
+                    const auto j0 = activeBlocks.y0(b);
+                    const auto j1 = activeBlocks.y1(b);
+                    for (auto i = activeBlocks.x0(b); i < activeBlocks.x1(b);
+                         i++)
+                    {
+                      fn(static_cast<std::size_t>(i * n + j0),
+                         static_cast<std::size_t>(i * n + j1));
+                    }
+                  }
+                });
+  }
 
-      double xi = std::clamp(std::floor(x * pInvSpacing), 0.0, pNumX - 1.0);
-      double yi = std::clamp(std::floor(y * pInvSpacing), 0.0, pNumY - 1.0);
-      double cellNr = xi * pNumY + yi;
-      firstCellParticle[(int)cellNr]--;
-      cellParticleIds[firstCellParticle[(int)cellNr]] = i;
+  // Scatter by blocks of scatterBlock x scatterBlock cells. A particle writes
+  // at most one cell past its block, so the blocks of one color of a 2 x 2
+  // checkerboard never share a cell and run concurrently straight into out.
+  // Every cell then gets its contributions in a fixed order, by color and
+  // then by particle index within a block, whatever the number of threads,
+  // so the sums are bitwise reproducible.
+  template<typename Fn>
+  void scatterBlocks(T* const* out, Fn&& fn)
+  {
+    auto& grid = scatterGrid;
+    grid.build(particles.x.data(),
+               particles.y.data(),
+               static_cast<std::size_t>(numParticles));
+
+    for (auto color = 0; color < 4; color++) {
+      const auto bx = color & 1;
+      const auto by = color >> 1;
+      const auto rows = (grid.numY + 1 - by) / 2;
+      const auto blocks = ((grid.numX + 1 - bx) / 2) * rows;
+      parallelFor(static_cast<std::size_t>(blocks),
+                  1,
+                  [&](std::size_t begin, std::size_t end, std::size_t)
+                  {
+                    for (auto k = begin; k < end; k++) {
+                      const auto b = static_cast<int>(k);
+                      const auto xi = bx + 2 * (b / rows);
+                      const auto yi = by + 2 * (b % rows);
+                      for (const auto id :
+                           grid.particlesIn(xi * grid.numY + yi))
+                      {
+                        fn(out, static_cast<std::size_t>(id));
+                      }
+                    }
+                  });
     }
+  }
 
-    double minDist = 2.0 * particleRadius;
-    double minDist2 = minDist * minDist;
+  void integrateParticles(T dt, T gravity)
+  {
+    parallelFor(static_cast<std::size_t>(numParticles),
+                particleGrain,
+                [&](std::size_t begin, std::size_t end, std::size_t)
+                {
+                  auto i = integrateParticlesSIMD(
+                      particles, begin, end, dt, gravity);
+                  for (; i < end; i++) {
+                    particles.vy[i] += dt * gravity;
+                    particles.x[i] += particles.vx[i] * dt;
+                    particles.y[i] += particles.vy[i] * dt;
+                  }
+                });
+  }
 
-    for (auto iter = 0; iter < numIters; iter++) {
-      for (auto i = 0; i < numParticles; i++) {
-        auto& ppos = particlePos[i];
-        const double px = ppos.x;
-        const double py = ppos.y;
-
-        double pxi = std::floor(px * pInvSpacing);
-        double pyi = std::floor(py * pInvSpacing);
-        double x0 = std::max(pxi - 1.0, 0.0);
-        double y0 = std::max(pyi - 1.0, 0.0);
-        double x1 = std::min(pxi + 1.0, pNumX - 1.0);
-        double y1 = std::min(pyi + 1.0, pNumY - 1.0);
-
-        for (auto xi = x0; xi <= x1; xi++) {
-          for (auto yi = y0; yi <= y1; yi++) {
-            double cellNr = xi * pNumY + yi;
-            int first = firstCellParticle[(int)cellNr];
-            int last = firstCellParticle[(int)cellNr + 1];
-            for (auto j = first; j < last; j++) {
-              int id = cellParticleIds[j];
-              if (id == i) {
-                continue;
-              }
-              auto& ppos = particlePos[id];
-              const double qx = ppos.x;
-              const double qy = ppos.y;
-
-              double dx = qx - px;
-              double dy = qy - py;
-              double d2 = dx * dx + dy * dy;
-              if (d2 > minDist2 || std::abs(d2) < DBL_MIN) {
-                continue;
-              }
-              double d = std::sqrt(d2);
-              double s = 0.5 * (minDist - d) / d;
-              dx *= s;
-              dy *= s;
-              auto& ppos1 = particlePos[i];
-              ppos1.x -= dx;
-              ppos1.y -= dy;
-              auto& ppos2 = particlePos[id];
-              ppos2.x += dx;
-              ppos2.y += dy;
-
-              // diffuse colors
-              // for (var k = 0; k < 3; k++) {
-              //   var color0 = this.particleColor[3 * i + k];
-              //   var color1 = this.particleColor[3 * id + k];
-              //   var color = (color0 + color1) * 0.5;
-              //   this.particleColor[3 * i + k] =
-              //       color0 + (color - color0) * colorDiffusionCoeff;
-              //   this.particleColor[3 * id + k] =
-              //       color1 + (color - color1) * colorDiffusionCoeff;
-              // }
-            }
-          }
-        }
-      }
-    }
+  void binParticles()
+  {
+    particleGrid.build(particles.x.data(),
+                       particles.y.data(),
+                       static_cast<std::size_t>(numParticles));
   }
 
-  void handleParticleCollisions(double obstacleX,
-                                double obstacleY,
-                                double obstacleRadius)
+  // Pushes particle i away from the particles binned around its cell
+  void separateParticle(int i, T minDist)
   {
-    double h = 1.0 / fInvSpacing;
-    double r = particleRadius;
-    double orr = obstacleRadius;
-    double or2 = orr * orr;
-    double minDist = obstacleRadius + r;
-    double minDist2 = minDist * minDist;
+    const T minDist2 = minDist * minDist;
+    auto& x = particles.x;
+    auto& y = particles.y;
+    const T px = x[i];
+    const T py = y[i];
+
+    particleGrid.forEachNear(
+        particleGrid.cellOfParticle(static_cast<std::size_t>(i)),
+        [&](int id)
+        {
+          if (id == i) {
+            return;
+          }
+          const T qx = x[id];
+          const T qy = y[id];
+
+          T dx = qx - px;
+          T dy = qy - py;
+          T d2 = dx * dx + dy * dy;
+          if (d2 > minDist2 || std::abs(d2) < std::numeric_limits<T>::min()) {
+            return;
+          }
+          T d = std::sqrt(d2);
+          T s = T(0.5) * (minDist - d) / d;
+          dx *= s;
+          dy *= s;
+          x[i] -= dx;
+          y[i] -= dy;
+          x[id] += dx;
+          y[id] += dy;
+
+          // diffuse colors
+          // for (var k = 0; k < 3; k++) {
+          //   var color0 = this.particleColor[3 * i + k];
+          //   var color1 = this.particleColor[3 * id + k];
+          //   var color = (color0 + color1) * 0.5;
+          //   this.particleColor[3 * i + k] =
+          //       color0 + (color - color0) * colorDiffusionCoeff;
+          //   this.particleColor[3 * id + k] =
+          //       color1 + (color - color1) * colorDiffusionCoeff;
+          // }
+        });
+  }
 
-    double minX = h + r;
-    double maxX = (this->fNumX - 1) * h - r;
-    double minY = h + r;
-    double maxY = (this->fNumY - 1) * h - r;
+  void pushParticlesApart(int numIters)
+  {
+    T colorDiffusionCoeff = T(0.001f);
 
-    for (auto i = 0; i < numParticles; i++) {
-      auto& ppos = particlePos[i];
-      double x = ppos.x;
-      double y = ppos.y;
+    binParticles();
 
-      double dx = x - obstacleX;
-      double dy = y - obstacleY;
-      double d2 = dx * dx + dy * dy;
+    T minDist = T(2) * particleRadius;
 
-      // obstacle collision
-      if (d2 < minDist2) {
-        this->particleVel[(2 * i)] = scene.obstacleVelX;
-        this->particleVel[(2 * i) + 1] = scene.obstacleVelY;
+    if (pool == nullptr && !scene.deterministic) {
+      for (auto iter = 0; iter < numIters; iter++) {
+        for (auto i = 0; i < numParticles; i++) {
+          separateParticle(i, minDist);
+        }
       }
+      return;
+    }
 
-      // wall collision
-      if (x < minX) {
-        x = minX;
-        particleVel[2 * i] = 0.0;
-      }
-      if (x > maxX) {
-        x = maxX;
-        particleVel[2 * i] = 0.0;
-      }
-      if (y < minY) {
-        y = minY;
-        particleVel[(2 * i) + 1] = 0.0;
-      }
-      if (y > maxY) {
-        y = maxY;
-        particleVel[(2 * i) + 1] = 0.0;
+    // A particle binned in column x only touches columns x - 1 .. x + 1, so
+    // columns three apart never share a particle and each x % 3 class can
+    // run its columns concurrently.
+    const auto& grid = particleGrid;
+    for (auto iter = 0; iter < numIters; iter++) {
+      for (auto color = 0; color < 3; color++) {
+        parallelFor(
+            static_cast<std::size_t>((grid.numX + 2 - color) / 3),
+            1,
+            [&](std::size_t begin, std::size_t end, std::size_t)
+            {
+              for (auto k = begin; k < end; k++) {
+                const auto xi = color + 3 * static_cast<int>(k);
+                for (auto yi = 0; yi < grid.numY; yi++) {
+                  for (const auto id : grid.particlesIn(xi * grid.numY + yi))
+                  {
+                    separateParticle(id, minDist);
+                  }
+                }
+              }
+            });
       }
+    }
+  }
 
-      ppos.x = x;
-      ppos.y = y;
+  // Pushes the particles touching an obstacle back out to its surface, less
+  // the velocity they had into it, then puts the particles outside the tank
+  // back on the walls
+  void handleParticleCollisions()
+  {
+    for (const auto& o : obstacles.list) {
+      collideObstacle(o);
     }
+
+    T h = T(1) / fInvSpacing;
+    T r = particleRadius;
+
+    T minX = h + r;
+    T maxX = T(this->fNumX - 1) * h - r;
+    T minY = h + r;
+    T maxY = T(this->fNumY - 1) * h - r;
+
+    const ParticleCollision<T> collision {minX, maxX, minY, maxY};
+
+    parallelFor(
+        static_cast<std::size_t>(numParticles),
+        particleGrain,
+        [&](std::size_t begin, std::size_t end, std::size_t)
+        {
+          auto i = collideParticlesSIMD(particles, begin, end, collision);
+          for (; i < end; i++) {
+            T x = particles.x[i];
+            T y = particles.y[i];
+
+            // wall collision
+            if (x < minX) {
+              x = minX;
+              particles.vx[i] = 0;
+            }
+            if (x > maxX) {
+              x = maxX;
+              particles.vx[i] = 0;
+            }
+            if (y < minY) {
+              y = minY;
+              particles.vy[i] = 0;
+            }
+            if (y > maxY) {
+              y = maxY;
+              particles.vy[i] = 0;
+            }
+
+            particles.x[i] = x;
+            particles.y[i] = y;
+          }
+        });
   }
 
-  void updateParticleDensity()
+  // Collides the particles around o with it, found through particleGrid.
+  // The separation moved them after binning, by well under a grid cell, so
+  // the search reaches a cell further out.
+  void collideObstacle(const Obstacle<T>& o)
   {
-    double n = fNumY;
-    double h = this->h;
-    double h1 = fInvSpacing;
-    double h2 = 0.5 * h;
+    const auto& grid = particleGrid;
+    const T r = particleRadius;
+    const T reach = r + T(1) / grid.invSpacing;
+    const auto b = o.bounds();
+    const auto first = grid.cellOf(b.x0 - reach, b.y0 - reach);
+    const auto last = grid.cellOf(b.x1 + reach, b.y1 + reach);
+    const auto xi0 = grid.cellX(first);
+    const auto yi0 = grid.cellY(first);
+    const auto yi1 = grid.cellY(last);
+
+    // a particle is binned in one column only, so columns run concurrently
+    parallelFor(
+        static_cast<std::size_t>(grid.cellX(last) - xi0 + 1),
+        4,
+        [&](std::size_t begin, std::size_t end, std::size_t)
+        {
+          grid.forEachInCells(
+              xi0 + static_cast<int>(begin),
+              yi0,
+              xi0 + static_cast<int>(end) - 1,
+              yi1,
+              [&](int id)
+              {
+                const auto i = static_cast<std::size_t>(id);
+                T nx;
+                T ny;
+                const T d =
+                    o.distance(particles.x[i], particles.y[i], nx, ny);
+                if (d >= r) {
+                  return;
+                }
+                particles.x[i] += (r - d) * nx;
+                particles.y[i] += (r - d) * ny;
+                const T vn = (particles.vx[i] - o.vx) * nx
+                    + (particles.vy[i] - o.vy) * ny;
+                if (vn < T(0)) {
+                  particles.vx[i] -= vn * nx;
+                  particles.vy[i] -= vn * ny;
+                }
+              });
+        });
+  }
 
-    std::fill(particleDensity.begin(), particleDensity.end(), 0.0);
+  // obstacle of either cell of a face, nullptr for none
+  const Obstacle<T>* solidAt(std::size_t a, std::size_t b) const
+  {
+    const auto* o = obstacles.at(a);
+    return o != nullptr ? o : obstacles.at(b);
+  }
 
-    for (auto i = 0; i < numParticles; i++) {
-      auto& ppos = particlePos[i];
-      double x = ppos.x;
-      double y = ppos.y;
+  // Bilinear weights of the four grid samples around a particle, for the grid
+  // staggered by (dx, dy)
+  struct Stencil
+  {
+    std::array<int, 4> nr;
+    std::array<T, 4> w;
+  };
 
-      x = std::clamp(x, h, (this->fNumX - 1.0) * h);
-      y = std::clamp(y, h, (this->fNumY - 1.0) * h);
+  // Linear weights along one axis: samples i0 and i1 of an axis with num
+  // samples shifted by `shift`, weighted 1 - t and t. pos is clamped to the
+  // interior of the grid already.
+  struct AxisWeights
+  {
+    int i0, i1;
+    T t;
+  };
 
-      double x0 = std::floor((x - h2) * h1);
-      double tx = ((x - h2) - x0 * h) * h1;
-      double x1 = std::min(x0 + 1.0, fNumX - 2.0);
+  AxisWeights axisWeights(T pos, T shift, int num) const
+  {
+    T h1 = fInvSpacing;
+    T pos0 = pos - shift;
+    int i0 = std::min(static_cast<int>(std::floor(pos0 * h1)), num - 2);
+    T t = (pos0 - T(i0) * h) * h1;
+    return {i0, std::min(i0 + 1, num - 2), t};
+  }
 
-      double y0 = std::floor((y - h2) * h1);
-      double ty = ((y - h2) - y0 * h) * h1;
-      double y1 = std::min(y0 + 1.0, fNumY - 2.0);
+  static Stencil stencil(const AxisWeights& ax, const AxisWeights& ay, int n)
+  {
+    T sx = T(1) - ax.t;
+    T sy = T(1) - ay.t;
+
+    return {{ax.i0 * n + ay.i0,
+             ax.i1 * n + ay.i0,
+             ax.i1 * n + ay.i1,
+             ax.i0 * n + ay.i1},
+            {sx * sy, ax.t * sy, ax.t * ay.t, sx * ay.t}};
+  }
 
-      double sx = 1.0 - tx;
-      double sy = 1.0 - ty;
+  Stencil stencil(std::size_t i, T dx, T dy) const
+  {
+    T x = std::clamp(particles.x[i], h, T(fNumX - 1) * h);
+    T y = std::clamp(particles.y[i], h, T(fNumY - 1) * h);
+    return stencil(axisWeights(x, dx, fNumX), axisWeights(y, dy, fNumY), fNumY);
+  }
 
-      if (x0 < fNumX && y0 < fNumY) {
-        particleDensity[(int)((x0 * n) + y0)] += (sx * sy);
-      }
-      if (x1 < fNumX && y0 < fNumY) {
-        particleDensity[(int)((x1 * n) + y0)] += (tx * sy);
-      }
-      if (x1 < fNumX && y1 < fNumY) {
-        particleDensity[(int)((x1 * n) + y1)] += (tx * ty);
-      }
-      if (x0 < fNumX && y1 < fNumY) {
-        particleDensity[(int)((x0 * n) + y1)] += (sx * ty);
-      }
-    }
+  // Particle-to-grid transfer in one sweep over the particles: marks the
+  // fluid cells and splats u, v, their weights and the particle density. The
+  // three staggered stencils share their clamped position and two of the
+  // four axis weights each.
+  void transferToGrid()
+  {
+    int n = fNumY;
+    T h = this->h;
+    T h1 = fInvSpacing;
+    T h2 = T(0.5) * h;
+
+    // Only the active blocks hold fluid or anything but zeros in the
+    // grids, so clearing them clears the whole grid
+    forBlockCells(activeBlocks.list,
+                  [&](std::size_t begin, std::size_t end)
+                  {
+                    for (auto i = begin; i < end; i++) {
+                      prevU[i] = u[i];
+                      prevV[i] = v[i];
+                      for (auto* f : {&u, &v, &du, &dv, &particleDensity, &p})
+                      {
+                        (*f)[i] = T(0);
+                      }
+                      cellType[i] =
+                          std::abs(this->s[i]) < std::numeric_limits<T>::min()
+                          ? CellType::SOLID
+                          : CellType::AIR;
+                    }
+                  });
+
+    std::array<T*, maxScatterFields> out {
+        u.data(), du.data(), v.data(), dv.data(), particleDensity.data()};
+    scatter(
+        out.size(),
+        out.data(),
+        [&](T* const* acc, std::size_t i)
+        {
+          const T px = particles.x[i];
+          const T py = particles.y[i];
+
+          int xi = std::clamp(
+              static_cast<int>(std::floor(px * h1)), 0, fNumX - 1);
+          int yi = std::clamp(
+              static_cast<int>(std::floor(py * h1)), 0, fNumY - 1);
+          // particles sharing a cell all store the same value
+          std::atomic_ref<CellType> type(cellType[xi * n + yi]);
+          if (type.load(std::memory_order_relaxed) == CellType::AIR) {
+            type.store(CellType::FLUID, std::memory_order_relaxed);
+          }
+          activeBlocks.mark(xi, yi);
+
+          T x = std::clamp(px, h, T(fNumX - 1) * h);
+          T y = std::clamp(py, h, T(fNumY - 1) * h);
+          const auto ax = axisWeights(x, T(0), fNumX);
+          const auto axh = axisWeights(x, h2, fNumX);
+          const auto ay = axisWeights(y, T(0), fNumY);
+          const auto ayh = axisWeights(y, h2, fNumY);
+
+          const auto su = stencil(ax, ayh, n);
+          const auto sv = stencil(axh, ay, n);
+          const auto sd = stencil(axh, ayh, n);
+          const T vx = particles.vx[i];
+          const T vy = particles.vy[i];
+          for (auto k = 0; k < 4; k++) {
+            acc[0][su.nr[k]] += vx * su.w[k];
+            acc[1][su.nr[k]] += su.w[k];
+            acc[2][sv.nr[k]] += vy * sv.w[k];
+            acc[3][sv.nr[k]] += sv.w[k];
+            acc[4][sd.nr[k]] += sd.w[k];
+          }
+        });
+
+    // normalize, then restore solid cells: faces of an obstacle move with
+    // it, the others keep their velocity
+
+    forBlockCells(
+        activeBlocks.list,
+        [&](std::size_t begin, std::size_t end)
+        {
+          const auto un = static_cast<std::size_t>(n);
+          for (auto c = begin; c < end; c++) {
+            if (du[c] > T(0)) {
+              u[c] /= du[c];
+            }
+            if (dv[c] > T(0)) {
+              v[c] /= dv[c];
+            }
+            bool solid = cellType[c] == CellType::SOLID;
+            if (solid || (c >= un && cellType[c - un] == CellType::SOLID)) {
+              const auto* o = solidAt(c, c >= un ? c - un : c);
+              u[c] = o != nullptr ? o->vx : prevU[c];
+            }
+            if (solid
+                || (c % un > 0 && cellType[c - 1] == CellType::SOLID))
+            {
+              const auto* o = solidAt(c, c % un > 0 ? c - 1 : c);
+              v[c] = o != nullptr ? o->vy : prevV[c];
+            }
+          }
+        });
+
+    // blocks that just dropped out go back to all zero
+    forBlockCells(activeBlocks.released,
+                  [&](std::size_t begin, std::size_t end)
+                  {
+                    std::fill_n(prevU.data() + begin, end - begin, T(0));
+                    std::fill_n(prevV.data() + begin, end - begin, T(0));
+                  });
 
-    if (std::abs(particleRestDensity) < DBL_MIN) {
-      double sum = 0.0;
-      double numFluidCells = 0.0;
+    if (std::abs(particleRestDensity) < std::numeric_limits<T>::min()) {
+      T sum = 0;
+      int numFluidCells = 0;
 
-      for (auto i = 0u; i < fNumCells; i++) {
+      for (auto i = 0; i < fNumCells; i++) {
         if (cellType[i] == CellType::FLUID) {
           sum += particleDensity[i];
           numFluidCells++;
         }
         if (numFluidCells > 0) {
-          particleRestDensity = sum / numFluidCells;
+          particleRestDensity = sum / T(numFluidCells);
         }
       }
     }
   }
 
-  void transferVelocities(bool toGrid, double flipRatio)
+  void transferVelocities(bool toGrid, T flipRatio)
   {
-    double n = fNumY;
-    double h = this->h;
-    double h1 = fInvSpacing;
-    double h2 = 0.5 * h;
-
     if (toGrid) {
-      prevU = u;
-      prevV = v;
-
-      std::fill(du.begin(), du.end(), 0.0);
-      std::fill(dv.begin(), dv.end(), 0.0);
-      std::fill(u.begin(), u.end(), 0.0);
-      std::fill(v.begin(), v.end(), 0.0);
-
-      for (auto i = 0; i < fNumCells; i++) {
-        cellType[i] =
-            std::abs(this->s[i]) < DBL_MIN ? CellType::SOLID : CellType::AIR;
-      }
-
-      for (auto i = 0; i < numParticles; i++) {
-        auto& ppos = particlePos[i];
-        double x = ppos.x;
-        double y = ppos.y;
-        double xi = std::clamp(std::floor(x * h1), 0.0, fNumX - 1.0);
-        double yi = std::clamp(std::floor(y * h1), 0.0, fNumY - 1.0);
-        int cellNr = (int)(xi * n + yi);
-        if (cellType[cellNr] == CellType::AIR) {
-          cellType[cellNr] = CellType::FLUID;
-        }
-      }
+      transferToGrid();
+      return;
     }
 
+    int n = fNumY;
+    T h2 = T(0.5) * h;
+    const auto count = static_cast<std::size_t>(numParticles);
+
     for (auto component = 0; component < 2; component++) {
-      double dx = component == 0 ? 0.0 : h2;
-      double dy = component == 0 ? h2 : 0.0;
+      T dx = component == 0 ? T(0) : h2;
+      T dy = component == 0 ? h2 : T(0);
 
       auto& f = component == 0 ? u : v;
       auto& prevF = component == 0 ? prevU : prevV;
-      auto& d = component == 0 ? du : dv;
-
-      for (auto i = 0; i < numParticles; i++) {
-        auto& ppos = particlePos[i];
-        double x = ppos.x;
-        double y = ppos.y;
-        x = std::clamp(x, h, (fNumX - 1.0) * h);
-        y = std::clamp(y, h, (fNumY - 1.0) * h);
-
-        double x0 = std::min(std::floor((x - dx) * h1), fNumX - 2.0);
-        double tx = ((x - dx) - x0 * h) * h1;
-        double x1 = std::min(x0 + 1.0, fNumX - 2.0);
-
-        double y0 = std::min(std::floor((y - dy) * h1), fNumY - 2.0);
-        double ty = ((y - dy) - y0 * h) * h1;
-        double y1 = std::min(y0 + 1.0, fNumY - 2.0);
-
-        double sx = 1.0 - tx;
-        double sy = 1.0 - ty;
-
-        double d0 = sx * sy;
-        double d1 = tx * sy;
-        double d2 = tx * ty;
-        double d3 = sx * ty;
-
-        double nr0 = x0 * n + y0;
-        double nr1 = x1 * n + y0;
-        double nr2 = x1 * n + y1;
-        double nr3 = x0 * n + y1;
-
-        if (toGrid) {
-          double pv = particleVel[(2 * i) + component];
-          f[(int)nr0] += pv * d0;
-          d[(int)nr0] += d0;
-
-          f[(int)nr1] += pv * d1;
-          d[(int)nr1] += d1;
-
-          f[(int)nr2] += pv * d2;
-          d[(int)nr2] += d2;
-
-          f[(int)nr3] += pv * d3;
-          d[(int)nr3] += d3;
-        } else {
-          int offset = component == 0 ? n : 1;
-          auto vcell = [this, offset](int idx)
+      auto& vel = component == 0 ? particles.vx : particles.vy;
+
+      int offset = component == 0 ? n : 1;
+      auto vcell = [this, offset](int idx)
+      {
+        return (cellType[idx] != CellType::AIR
+                || cellType[idx - offset] != CellType::AIR)
+            ? T(1)
+            : T(0);
+      };
+
+      parallelFor(
+          count,
+          particleGrain,
+          [&](std::size_t begin, std::size_t end, std::size_t)
           {
-            return (cellType[idx] != CellType::AIR
-                    || cellType[idx - offset] != CellType::AIR)
-                ? 1.0
-                : 0.0;
-          };
-          double valid0 = vcell((int)nr0);
-          double valid1 = vcell((int)nr1);
-          double valid2 = vcell((int)nr2);
-          double valid3 = vcell((int)nr3);
-
-          double v = particleVel[(2 * i) + component];
-          double d = valid0 * d0 + valid1 * d1 + valid2 * d2 + valid3 * d3;
-
-          if (d > 0.0) {
-            double picV =
-                (valid0 * d0 * f[(int)nr0] + valid1 * d1 * f[(int)nr1]
-                 + valid2 * d2 * f[(int)nr2] + valid3 * d3 * f[(int)nr3])
-                / d;
-
-            double corr = (valid0 * d0 * (f[(int)nr0] - prevF[(int)nr0])
-                           + valid1 * d1 * (f[(int)nr1] - prevF[(int)nr1])
-                           + valid2 * d2 * (f[(int)nr2] - prevF[(int)nr2])
-                           + valid3 * d3 * (f[(int)nr3] - prevF[(int)nr3]))
-                / d;
-            double flipV = v + corr;
-
-            particleVel[(2 * i) + component] =
-                (1.0 - flipRatio) * picV + flipRatio * flipV;
-          }
-        }
-      }
-      if (toGrid) {
-        for (auto i = 0; i < f.size(); i++) {
-          if (d[i] > 0.0) {
-            f[i] /= d[i];
-          }
-        }
+            for (auto i = begin; i < end; i++) {
+              const auto st = stencil(i, dx, dy);
+              T vel0 = vel[i];
+              T d = 0;
+              T pic = 0;
+              T corr = 0;
+              for (auto k = 0; k < 4; k++) {
+                T w = vcell(st.nr[k]) * st.w[k];
+                d += w;
+                pic += w * f[st.nr[k]];
+                corr += w * (f[st.nr[k]] - prevF[st.nr[k]]);
+              }
 
-        // restore solid cells
+              if (d > T(0)) {
+                T picV = pic / d;
+                T flipV = vel0 + corr / d;
 
-        for (auto i = 0; i < fNumX; i++) {
-          for (auto j = 0; j < fNumY; j++) {
-            bool solid = cellType[i * n + j] == CellType::SOLID;
-            if (solid
-                || (i > 0 && cellType[(i - 1) * n + j] == CellType::SOLID))
-            {
-              u[i * n + j] = prevU[i * n + j];
-            }
-            if (solid || (j > 0 && cellType[i * n + j - 1] == CellType::SOLID))
-            {
-              v[i * n + j] = prevV[i * n + j];
+                vel[i] = (T(1) - flipRatio) * picV + flipRatio * flipV;
+              }
             }
-          }
-        }
-      }
+          });
+    }
+  }
+
+  // One SOR update of cell (i, j), returns the divergence it removed
+  T relaxCell(int i, int j, T cp, T overRelaxation)
+  {
+    int n = fNumY;
+    if (cellType[(i * n) + j] != CellType::FLUID) {
+      return T(0);
     }
+
+    auto center = i * n + j;
+    auto left = (i - 1) * n + j;
+    auto right = (i + 1) * n + j;
+    auto bottom = i * n + j - 1;
+    auto top = i * n + j + 1;
+
+    // auto s = this.s[center];
+    auto sx0 = this->s[left];
+    auto sx1 = this->s[right];
+    auto sy0 = this->s[bottom];
+    auto sy1 = this->s[top];
+    auto s = sx0 + sx1 + sy0 + sy1;
+    if (std::abs(s) < std::numeric_limits<T>::min()) {
+      return T(0);
+    }
+
+    auto div =
+        this->u[right] - this->u[center] + this->v[top] - this->v[center];
+
+    T k = 1;
+    T compression = particleDensity[i * n + j] - particleRestDensity;
+    if (compression > T(0)) {
+      div = div - k * compression;
+    }
+
+    T p = -div / s;
+    p *= overRelaxation;
+    this->p[center] += cp * p;
+
+    this->u[center] -= sx0 * p;
+    this->u[right] += sx1 * p;
+    this->v[center] -= sy0 * p;
+    this->v[top] += sy1 * p;
+    return std::abs(div);
   }
 
   void solveIncompressibility(int numIters,
-                              double dt,
-                              double overRelaxation,
+                              T dt,
+                              T overRelaxation,
                               bool compensateDrift = true)
   {
-    std::fill(p.begin(), p.end(), 0.0);
-    prevU = u;
-    prevV = v;
+    // p was cleared with the rest of the grids in transferToGrid()
+    forBlockCells(activeBlocks.list,
+                  [&](std::size_t begin, std::size_t end)
+                  {
+                    std::copy(u.data() + begin, u.data() + end, &prevU[begin]);
+                    std::copy(v.data() + begin, v.data() + end, &prevV[begin]);
+                  });
 
-    double n = fNumY;
-    double cp = density * h / dt;
+    T cp = density * h / dt;
 
     // for (auto i = 0; i < fNumCells; i++) {
     //   double u = this->u[i];
     //   double v = this->v[i];
     // }
 
-    for (auto iter = 0; iter < numIters; iter++) {
-      for (auto i = 1; i < fNumX - 1.0; i++) {
-        for (auto j = 1; j < fNumY - 1.0; j++) {
-          if (cellType[(i * n) + j] != CellType::FLUID) {
-            continue;
-          }
+    pressureStats = {0, 0.0};
+    // the sweeps only update cells when drift is compensated
+    if (!(particleRestDensity > T(0) && compensateDrift)) {
+      return;
+    }
 
-          auto center = i * n + j;
-          auto left = (i - 1) * n + j;
-          auto right = (i + 1) * n + j;
-          auto bottom = i * n + j - 1;
-          auto top = i * n + j + 1;
-
-          // auto s = this.s[center];
-          auto sx0 = this->s[left];
-          auto sx1 = this->s[right];
-          auto sy0 = this->s[bottom];
-          auto sy1 = this->s[top];
-          auto s = sx0 + sx1 + sy0 + sy1;
-          if (std::abs(s) < DBL_MIN) {
-            continue;
-          }
+    if (scene.pressureSolver == RED_BLACK) {
+      solveRedBlack(numIters, cp, overRelaxation);
+      return;
+    }
+    if (scene.pressureSolver == MGPCG) {
+      solveMultigrid(numIters, cp);
+      return;
+    }
+
+    const auto& rows = activeBlocks;
+    T target = 0;
+    for (auto iter = 0; iter < numIters; iter++) {
+      T maxDiv = 0;
+      for (auto i = 1; i < fNumX - 1; i++) {
+        const auto col = static_cast<std::size_t>(i);
+        const auto j1 = std::min(rows.rowEnd[col], fNumY - 1);
+        for (auto j = std::max(rows.rowBegin[col], 1); j < j1; j++) {
+          maxDiv = std::max(maxDiv, relaxCell(i, j, cp, overRelaxation));
+        }
+      }
+      pressureStats.iterations = iter + 1;
+      if (iter == 0) {
+        target = sorTarget(maxDiv);
+      }
+      if (maxDiv <= target) {
+        break;
+      }
+    }
+    pressureStats.residual = static_cast<double>(maxDivergence());
+  }
 
-          auto div =
-              this->u[right] - this->u[center] + this->v[top] - this->v[center];
+  // Divergence the SOR sweeps stop at, from what the first sweep met
+  T sorTarget(T firstDiv) const
+  {
+    return std::max(scene.pressureTolerance,
+                    scene.pressureReduction * firstDiv);
+  }
 
-          if (particleRestDensity > 0.0 && compensateDrift) {
-            double k = 1.0;
-            double compression =
-                particleDensity[i * n + j] - particleRestDensity;
-            if (compression > 0.0) {
-              div = div - k * compression;
+  // Largest divergence in a fluid cell the sweeps would update, as
+  // relaxCell measures it
+  T maxDivergence()
+  {
+    const auto n = static_cast<std::size_t>(fNumY);
+    workerMax.assign(pool == nullptr ? 1 : pool->size(), T(0));
+    parallelFor(
+        static_cast<std::size_t>(fNumX) - 2,
+        cellGrain / n + 1,
+        [&](std::size_t begin, std::size_t end, std::size_t worker)
+        {
+          T maxDiv = 0;
+          for (auto i = begin + 1; i < end + 1; i++) {
+            const auto j0 = std::max<std::size_t>(
+                1, static_cast<std::size_t>(activeBlocks.rowBegin[i]));
+            const auto j1 = std::min<std::size_t>(
+                n - 1, static_cast<std::size_t>(activeBlocks.rowEnd[i]));
+            for (auto j = j0; j < j1; j++) {
+              const auto c = i * n + j;
+              const T sum = s[c - n] + s[c + n] + s[c - 1] + s[c + 1];
+              if (cellType[c] != CellType::FLUID
+                  || std::abs(sum) < std::numeric_limits<T>::min())
+              {
+                continue;
+              }
+              T div = u[c + n] - u[c] + v[c + 1] - v[c];
+              const T compression = particleDensity[c] - particleRestDensity;
+              if (compression > T(0)) {
+                div -= compression;
+              }
+              maxDiv = std::max(maxDiv, std::abs(div));
             }
+          }
+          workerMax[worker] = std::max(workerMax[worker], maxDiv);
+        });
+    return *std::max_element(workerMax.begin(), workerMax.end());
+  }
 
-            double p = -div / s;
-            p *= overRelaxation;
-            this->p[center] += cp * p;
+  // Cells of one checkerboard color share no faces, so a color sweep can
+  // visit them in any order and split the columns between workers.
+  void solveRedBlack(int numIters, T cp, T overRelaxation)
+  {
+    const auto numX = static_cast<std::size_t>(fNumX);
+    const auto n = static_cast<std::size_t>(fNumY);
+    if (numX < 3 || n < 3) {
+      return;
+    }
+    const PressureSweep<T> sweep {u.data(),
+                                  v.data(),
+                                  p.data(),
+                                  s.data(),
+                                  particleDensity.data(),
+                                  cellType.data(),
+                                  activeBlocks.rowBegin.data(),
+                                  activeBlocks.rowEnd.data(),
+                                  n,
+                                  cp,
+                                  overRelaxation,
+                                  particleRestDensity};
+    const bool simd = hasAVX2();
+    // largest divergence per worker, a chunk only ever raises its own slot
+    workerMax.assign(pool == nullptr ? 1 : pool->size(), T(0));
+
+    T target = 0;
+    for (auto iter = 0; iter < numIters; iter++) {
+      std::fill(workerMax.begin(), workerMax.end(), T(0));
+      for (auto color = 0; color < 2; color++) {
+        parallelFor(
+            numX - 2,
+            cellGrain / n + 1,
+            [&](std::size_t begin, std::size_t end, std::size_t worker)
+            {
+              T maxDiv = 0;
+              if (simd) {
+                maxDiv = sweepPressureAVX2(sweep, color, begin + 1, end + 1);
+              } else {
+                const auto c = static_cast<std::size_t>(color);
+                for (auto i = begin + 1; i < end + 1; i++) {
+                  const auto j0 = std::max<std::size_t>(
+                      1, static_cast<std::size_t>(sweep.rowBegin[i]));
+                  const auto j1 = std::min<std::size_t>(
+                      n - 1, static_cast<std::size_t>(sweep.rowEnd[i]));
+                  for (auto j = j0 + ((i + j0 + c) & 1); j < j1; j += 2) {
+                    maxDiv = std::max(maxDiv,
+                                      relaxCell(static_cast<int>(i),
+                                                static_cast<int>(j),
+                                                cp,
+                                                overRelaxation));
+                  }
+                }
+              }
+              workerMax[worker] = std::max(workerMax[worker], maxDiv);
+            });
+      }
+      const T maxDiv = *std::max_element(workerMax.begin(), workerMax.end());
+      pressureStats.iterations = iter + 1;
+      if (iter == 0) {
+        target = sorTarget(maxDiv);
+      }
+      if (maxDiv <= target) {
+        break;
+      }
+    }
+    pressureStats.residual = static_cast<double>(maxDivergence());
+  }
 
-            this->u[center] -= sx0 * p;
-            this->u[right] += sx1 * p;
-            this->v[center] -= sy0 * p;
-            this->v[top] += sy1 * p;
-          }
+  // Solves the system the SOR sweeps relax towards: for every fluid cell the
+  // net outflow, drift compensation included, is driven to zero. numIters
+  // caps the conjugate gradient iterations.
+  void solveMultigrid(int numIters, T cp)
+  {
+    const auto& blocks = activeBlocks;
+    if (blocks.boundsX1 <= blocks.boundsX0) {
+      return;
+    }
+    // The solve runs on the box around the active blocks, which holds all
+    // the fluid. Its outer ring is either the tank wall or an empty halo
+    // block, so it makes the same boundary as the full grid would.
+    const auto x0 = static_cast<std::size_t>(blocks.boundsX0);
+    const auto y0 = static_cast<std::size_t>(blocks.boundsY0);
+    const auto nx = static_cast<std::size_t>(blocks.boundsX1) - x0;
+    const auto ny = static_cast<std::size_t>(blocks.boundsY1) - y0;
+    const auto n = static_cast<std::size_t>(fNumY);
+    const auto cells = nx * ny;
+    pressureRhs.assign(cells, T(0));
+    pressureX.assign(cells, T(0));
+    boxType.resize(cells);
+    boxS.resize(cells);
+
+    for (auto i = 0UL; i < nx; i++) {
+      for (auto j = 0UL; j < ny; j++) {
+        const auto c = (x0 + i) * n + y0 + j;
+        const auto bc = i * ny + j;
+        boxType[bc] = cellType[c];
+        boxS[bc] = s[c];
+        const bool border = i == 0 || j == 0 || i + 1 == nx || j + 1 == ny;
+        if (border || cellType[c] != CellType::FLUID) {
+          continue;
+        }
+        auto div = u[c + n] - u[c] + v[c + 1] - v[c];
+        T compression = particleDensity[c] - particleRestDensity;
+        if (compression > T(0)) {
+          div = div - compression;
         }
+        pressureRhs[bc] = -div;
+      }
+    }
+
+    multigrid.build(nx, ny, boxType.data(), boxS.data());
+    const auto result = multigrid.solve(pressureRhs.data(),
+                                        pressureX.data(),
+                                        scene.pressureTolerance,
+                                        numIters);
+    pressureStats = {result.iterations, result.residual};
+
+    // the same face updates relaxCell makes, with the converged pressures;
+    // faces on the box edge see zero pressure on both sides
+    const auto* px = pressureX.data();
+    for (auto i = 0UL; i < nx; i++) {
+      for (auto j = 0UL; j < ny; j++) {
+        const auto c = (x0 + i) * n + y0 + j;
+        const auto bc = i * ny + j;
+        if (i > 0) {
+          u[c] += s[c] * px[bc - ny] - s[c - n] * px[bc];
+        }
+        if (j > 0) {
+          v[c] += s[c] * px[bc - 1] - s[c - 1] * px[bc];
+        }
+        p[c] = cp * px[bc];
       }
     }
   }
 
-  void setSciColor(int cellNr, double val, double minVal, double maxVal)
+  void setSciColor(int cellNr, T val, T minVal, T maxVal)
   {
-    val = std::min(std::max(val, minVal), maxVal - 0.0001f);
-    double d = maxVal - minVal;
-    val = std::abs(d) < 0.000001 ? 0.5 : (val - minVal) / d;
-    double m = 0.25;
-    double num = std::floor(val / m);
-    double s = (val - num * m) / m;
-    double r, g, b;
-
-    switch ((int)num) {
+    val = std::min(std::max(val, minVal), maxVal - T(0.0001f));
+    T d = maxVal - minVal;
+    val = std::abs(d) < T(0.000001) ? T(0.5) : (val - minVal) / d;
+    T m = T(0.25);
+    T num = std::floor(val / m);
+    T s = (val - num * m) / m;
+    T r, g, b;
+
+    switch (static_cast<int>(num)) {
       case 0:
-        r = 0.0;
+        r = 0;
         g = s;
-        b = 1.0;
+        b = 1;
         break;
       case 1:
-        r = 0.0;
-        g = 1.0;
-        b = 1.0 - s;
+        r = 0;
+        g = 1;
+        b = T(1) - s;
         break;
       case 2:
         r = s;
-        g = 1.0;
-        b = 0.0;
+        g = 1;
+        b = 0;
         break;
       case 3:
-        r = 1.0;
-        g = 1.0 - s;
-        b = 0.0;
+        r = 1;
+        g = T(1) - s;
+        b = 0;
         break;
     }
 
     cellColor[cellNr] = {r, g, b};
   }
 
+  // Colors the blocks that were active at some point since the last call,
+  // which covers every cell whose color can have changed
   void updateCellColors()
   {
-    std::fill(cellColor.begin(), cellColor.end(), Color {0.0, 0.0, 0.0});
+    const auto blocks = activeBlocks.touchedBlocks();
+    activeBlocks.clearTouched();
+
+    forBlockCells(blocks,
+                  [&](std::size_t begin, std::size_t end)
+                  {
+                    for (auto i = begin; i < end; i++) {
+                      cellColor[i] = Color {0, 0, 0};
+                      if (cellType[i] == CellType::SOLID) {
+                        cellColor[i] = {T(0.5), T(0.5), T(0.5)};
+                      } else if (cellType[i] == CellType::FLUID) {
+                        // cellColor[i] = {0.0, 0.0, 1.0};
+                        T d = particleDensity[i];
+                        if (particleRestDensity > T(0)) {
+                          d /= particleRestDensity;
+                        }
+                        setSciColor(static_cast<int>(i), d, T(0), T(2));
+                      }
+                    }
+                  });
+  }
 
-    for (auto i = 0; i < fNumCells; i++) {
-      if (cellType[i] == CellType::SOLID) {
-        cellColor[i] = {0.5, 0.5, 0.5};
-      } else if (cellType[i] == CellType::FLUID) {
-        // cellColor[i] = {0.0, 0.0, 1.0};
-        double d = particleDensity[i];
-        if (particleRestDensity > 0.0) {
-          d /= particleRestDensity;
-        }
-        setSciColor(i, d, 0, 2.0);
-      }
+  // Substeps for a frame of dt from the fastest particle, the obstacle and
+  // what gravity can add over the frame
+  int substepCount(T dt, T gravity)
+  {
+    workerMax.assign(pool == nullptr ? 1 : pool->size(), T(0));
+    parallelFor(static_cast<std::size_t>(numParticles),
+                particleGrain,
+                [&](std::size_t begin, std::size_t end, std::size_t worker)
+                {
+                  T maxVel2 = 0;
+                  for (auto i = begin; i < end; i++) {
+                    const T vx = particles.vx[i];
+                    const T vy = particles.vy[i];
+                    maxVel2 = std::max(maxVel2, vx * vx + vy * vy);
+                  }
+                  workerMax[worker] = std::max(workerMax[worker], maxVel2);
+                });
+
+    const T particleVel =
+        std::sqrt(*std::max_element(workerMax.begin(), workerMax.end()));
+    const T obstacleVel = obstacles.maxSpeed();
+    const T maxVel =
+        std::max(particleVel, obstacleVel) + std::abs(gravity) * dt;
+
+    const T steps = std::ceil(maxVel * dt / (scene.cfl * h));
+    // written so a NaN velocity takes a single step
+    if (!(steps > T(1))) {
+      return 1;
     }
+    return static_cast<int>(std::min(steps, T(std::max(scene.maxSubSteps, 1))));
   }
 
-  void simulate(double dt,
-                double gravity,
-                double flipRatio,
+  void simulate(T dt,
+                T gravity,
+                T flipRatio,
                 int numPressureIters,
                 int numParticleIters,
-                double overRelaxation,
+                T overRelaxation,
                 bool compensateDrift,
-                bool separateParticles,
-                double obstacleX,
-                double obstacleY,
-                double obstacleRadius)
+                bool separateParticles)
   {
-    int numSubSteps = 1;
-    double sdt = dt / (double)numSubSteps;
+    auto& dragged = obstacles.list[static_cast<std::size_t>(sceneObstacle)];
+    dragged.x = scene.obstacleX;
+    dragged.y = scene.obstacleY;
+    dragged.vx = scene.obstacleVelX;
+    dragged.vy = scene.obstacleVelY;
+    obstacles.rasterize(s, cellType, activeBlocks);
+
+    int numSubSteps = substepCount(dt, gravity);
+    T sdt = dt / T(numSubSteps);
+    subSteps = numSubSteps;
+    PressureStats frameStats {0, 0.0};
 
     for (auto step = 0; step < numSubSteps; step++) {
+      if (scene.reorderInterval > 0
+          && ++stepsSinceReorder >= scene.reorderInterval)
+      {
+        reorderParticles();
+        stepsSinceReorder = 0;
+      }
       integrateParticles(sdt, gravity);
       if (separateParticles) {
         pushParticlesApart(numParticleIters);
+      } else {
+        binParticles();
       }
-      handleParticleCollisions(obstacleX, obstacleY, obstacleRadius);
-      transferVelocities(true, 0.0);
-      updateParticleDensity();
+      handleParticleCollisions();
+      transferVelocities(true, T(0));
       solveIncompressibility(
           numPressureIters, sdt, overRelaxation, compensateDrift);
+      frameStats.iterations += pressureStats.iterations;
+      frameStats.residual =
+          std::max(frameStats.residual, pressureStats.residual);
       transferVelocities(false, flipRatio);
     }
+    pressureStats = frameStats;
 
     // updateParticleColors();
     updateCellColors();
@@ -674,45 +1243,42 @@ public:
              scene.numParticleIters,
              scene.overRelaxation,
              scene.compensateDraft,
-             scene.separateParticles,
-             scene.obstacleX,
-             scene.obstacleY,
-             scene.obstacleRadius);
+             scene.separateParticles);
   }
 
-  FlipFluid(double width, double height)
+  // res is the number of grid cells across the tank height, the particle
+  // count grows with its square
+  FlipFluid(T width, T height, int res = 64)
   {
     // scene.obstacleRadius = 1.0;
-    scene.obstacleRadius = 0.15f;
-    scene.overRelaxation = 1.9f;
+    scene.obstacleRadius = T(0.15f);
+    scene.overRelaxation = T(1.9f);
 
-    scene.dt = 1.0 / 60.0;
+    scene.dt = T(1.0 / 60.0);
     scene.numPressureIters = 50;
     scene.numParticleIters = 2;
 
-    simHeight = 3.0;
+    simHeight = 3;
     simScale = height / simHeight;
     simWidth = width / simScale;
 
-    int res = 64;
-
-    double tankHeight = 1.0 * simHeight;
-    double tankWidth = 1.0 * simWidth;
+    T tankHeight = T(1) * simHeight;
+    T tankWidth = T(1) * simWidth;
 
-    double res_h = tankHeight / (double)res;
-    double density = 1000.0;
+    T res_h = tankHeight / T(res);
+    T density = 1000;
 
-    double relWaterHeight = 0.8f;
-    double relWaterWidth = 0.6f;
+    T relWaterHeight = T(0.8f);
+    T relWaterWidth = T(0.6f);
 
-    auto r = 0.3 * res_h;
-    auto dx = 2.0 * r;
-    auto dy = std::sqrt(3.0) / 2.0 * dx;
+    auto r = T(0.3) * res_h;
+    auto dx = T(2) * r;
+    auto dy = std::sqrt(T(3)) / T(2) * dx;
 
-    auto nx =
-        std::floor((relWaterWidth * tankWidth - 2.0 * res_h - 2.0 * r) / dx);
-    auto ny =
-        std::floor((relWaterHeight * tankHeight - 2.0 * res_h - 2.0 * r) / dy);
+    auto nx = static_cast<int>(
+        std::floor((relWaterWidth * tankWidth - T(2) * res_h - T(2) * r) / dx));
+    auto ny = static_cast<int>(std::floor(
+        (relWaterHeight * tankHeight - T(2) * res_h - T(2) * r) / dy));
     auto maxParticles = nx * ny;
 
     // ##################
@@ -725,12 +1291,12 @@ public:
 
     // create particles
 
-    auto p = 0;
+    auto p = 0UL;
     for (auto i = 0; i < nx; i++) {
       for (auto j = 0; j < ny; j++) {
-        auto& ppos = particlePos[p++];
-        ppos.x = res_h + r + dx * i + (j % 2 == 0 ? 0.0 : r);
-        ppos.y = res_h + r + dy * j;
+        particles.x[p] = res_h + r + dx * T(i) + (j % 2 == 0 ? T(0) : r);
+        particles.y[p] = res_h + r + dy * T(j);
+        p++;
       }
     }
 
@@ -739,57 +1305,97 @@ public:
     auto n = fNumY;
     for (auto i = 0; i < fNumX; i++) {
       for (auto j = 0; j < fNumY; j++) {
-        auto s = 1.0;  // fluid
-        if (i == 0 || i == (int)fNumX - 1 || j == 0 || j == (int)fNumY - 1) {
-          s = 0.0;  // solid
+        T s = 1;  // fluid
+        if (i == 0 || i == fNumX - 1 || j == 0 || j == fNumY - 1) {
+          s = 0;  // solid
         }
         this->s[i * n + j] = s;
       }
     }
 
-    setObstacle(3.0, 2.0, true);
+    sceneObstacle =
+        obstacles.add(Obstacle<T>::circle(scene.obstacleRadius));
+    setObstacle(3, 2, true);
   }
 
   Scene scene;
 
-  double simScale;
-  double simWidth, simHeight;
-
-  double density;
-  double fNumX, fNumY;
-  double h;
-  double fInvSpacing;
-  double fNumCells;
-
-  std::vector<double> u;
-  std::vector<double> v;
-  std::vector<double> du;
-  std::vector<double> dv;
-  std::vector<double> prevU;
-  std::vector<double> prevV;
-  std::vector<double> p;
-  std::vector<double> s;
+  T simScale;
+  T simWidth, simHeight;
+
+  T density;
+  int fNumX, fNumY;
+  T h;
+  T fInvSpacing;
+  int fNumCells;
+
+  std::vector<T> u;
+  std::vector<T> v;
+  std::vector<T> du;
+  std::vector<T> dv;
+  std::vector<T> prevU;
+  std::vector<T> prevV;
+  std::vector<T> p;
+  std::vector<T> s;
   std::vector<CellType> cellType;
   std::vector<Color> cellColor;
 
   int maxParticles;
-  std::vector<Particle> particlePos;
+  // positions and velocities, one aligned column each
+  ParticleColumns<T> particles;
   std::vector<Color> particleColor;
 
-  std::vector<double> particleVel;
-  std::vector<double> particleDensity;
+  std::vector<T> particleDensity;
 
-  double particleRestDensity;
+  T particleRestDensity;
 
-  double particleRadius;
-  double pInvSpacing;
-  double pNumX, pNumY;
-  double pNumCells;
-
-  std::vector<int> numCellParticles;
-  std::vector<int> firstCellParticle;
-  std::vector<int> cellParticleIds;
+  T particleRadius;
+  // bins the particles by position; pushParticlesApart() rebuilds it each
+  // substep and later passes of the substep can query it
+  SpatialGrid<T> particleGrid;
 
   int numParticles;
+
+  static constexpr std::size_t particleGrain = 1024;
+  static constexpr std::size_t cellGrain = 4096;
+  // active blocks per parallelFor() task, 64 blocks being 4096 cells
+  static constexpr std::size_t blockGrain = 64;
+  static constexpr std::size_t maxScatterFields = 5;
+  // cells per side of a scatterBlocks() block, at least 3 with room to
+  // spare for rounding at the block edges
+  static constexpr int scatterBlock = 8;
+
+  engine::ThreadPool* pool {nullptr};
+
+  PressureStats pressureStats {0, 0.0};
+  // substeps the last simulate() took
+  int subSteps {1};
+  MultigridPCG<T> multigrid;
+  // solveMultigrid() works on a box of the grid, these are its copies
+  std::vector<T> pressureRhs;
+  std::vector<T> pressureX;
+  std::vector<CellType> boxType;
+  std::vector<T> boxS;
+  // per-worker copies of the scattered grids, see scatter()
+  std::vector<T> workerAccum;
+  std::vector<T> workerMax;
+
+  // bins the particles by scatterBlocks() block
+  SpatialGrid<T> scatterGrid;
+  // Solids in the tank besides the walls. simulate() rasterizes them into s
+  // each frame and the particles collide with their SDFs every substep.
+  ObstacleSet<T> obstacles;
+  // the obstacle setObstacle() drags around, as described by the scene
+  int sceneObstacle {0};
+
+  // the 8 x 8 cell blocks around the fluid, the only cells the grid passes
+  // visit; see transferToGrid()
+  ActiveBlocks activeBlocks;
+
+  // see reorderParticles()
+  std::vector<int> cellOrder;
+  ParticleColumns<T> sortedParticles;
+  std::vector<Color> sortedColor;
+  int stepsSinceReorder {0};
 };
 }  // namespace sim
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+
+#include <flip/particles.hpp>
+
+namespace sim
+{
+enum CellType : int
+{
+  FLUID,
+  AIR,
+  SOLID
+};
+
+// Grid fields touched by one color of a red-black SOR pressure sweep. Cells
+// are stored column by column, n per column.
+template<typename T>
+struct PressureSweep
+{
+  T* u;
+  T* v;
+  T* p;
+  const T* s;
+  const T* density;
+  const CellType* type;
+  // rows [rowBegin[i], rowEnd[i]) of column i hold its fluid, clamped to the
+  // interior; both null means the whole column
+  const int* rowBegin;
+  const int* rowEnd;
+  std::size_t n;
+  T cp;
+  T overRelaxation;
+  T restDensity;
+};
+
+// True when the vector kernels below can run on this CPU
+bool hasAVX2();
+
+// Relaxes the cells of one color, (i + j) % 2 == color, in the interior of
+// columns [i0, i1). Cells of one color share no faces, so disjoint column
+// ranges may run concurrently. Returns the largest divergence met before
+// the updates. The float kernel covers twice the cells per instruction.
+auto sweepPressureAVX2(const PressureSweep<double>& sweep,
+                       int color,
+                       std::size_t i0,
+                       std::size_t i1) -> double;
+auto sweepPressureAVX2(const PressureSweep<float>& sweep,
+                       int color,
+                       std::size_t i0,
+                       std::size_t i1) -> float;
+
+// Tank walls the particles collide with
+template<typename T>
+struct ParticleCollision
+{
+  T minX, maxX, minY, maxY;
+};
+
+// True when the AVX-512 kernels below can run on this CPU
+bool hasAVX512();
+
+// The particle kernels run the widest vector unit present over as many
+// whole registers of particles [begin, end) as fit and return where they
+// stopped. The caller finishes the rest with the scalar loop, all of it when
+// the CPU has no AVX2.
+
+// v.y += dt * gravity, then x += v * dt
+auto integrateParticlesSIMD(ParticleColumns<double>& particles,
+                            std::size_t begin,
+                            std::size_t end,
+                            double dt,
+                            double gravity) -> std::size_t;
+auto integrateParticlesSIMD(ParticleColumns<float>& particles,
+                            std::size_t begin,
+                            std::size_t end,
+                            float dt,
+                            float gravity) -> std::size_t;
+
+// A particle outside the walls is put back on them with the velocity
+// through the wall zeroed
+auto collideParticlesSIMD(ParticleColumns<double>& particles,
+                          std::size_t begin,
+                          std::size_t end,
+                          const ParticleCollision<double>& collision)
+    -> std::size_t;
+auto collideParticlesSIMD(ParticleColumns<float>& particles,
+                          std::size_t begin,
+                          std::size_t end,
+                          const ParticleCollision<float>& collision)
+    -> std::size_t;
+}  // namespace sim
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <flip/kernels.hpp>
+
+namespace sim
+{
+// Conjugate gradient preconditioned with one multigrid V-cycle, for the
+// pressure Poisson system of a staggered grid. Unknowns live on FLUID cells;
+// every other cell is held at zero, which makes AIR cells Dirichlet
+// boundaries and SOLID cells (s == 0) closed walls. Cells are stored column by
+// column, ny per column, like FlipFluid's grids. T is the scalar of the grids,
+// dot products are summed in double either way.
+template<typename T = double>
+class MultigridPCG
+{
+public:
+  struct Result
+  {
+    int iterations;
+    double residual;  // max |b - Ax| on return
+  };
+
+  // Builds the operator and the coarse levels for the current cell types
+  void build(std::size_t nx,
+             std::size_t ny,
+             const CellType* type,
+             const T* s)
+  {
+    levels.resize(1);
+    auto& fine = levels[0];
+    fine.resize(nx, ny);
+    for (auto i = 0UL; i < nx; i++) {
+      for (auto j = 0UL; j < ny; j++) {
+        const auto c = i * ny + j;
+        // the border ring stays inactive so neighbours are always in range
+        const bool border = i == 0 || j == 0 || i == nx - 1 || j == ny - 1;
+        fine.air[c] = type[c] == AIR;
+        fine.fluid[c] = !border && type[c] == FLUID;
+        if (i > 0) {
+          fine.wx[c] = s[c - ny] * s[c];
+        }
+        if (j > 0) {
+          fine.wy[c] = s[c - 1] * s[c];
+        }
+      }
+    }
+    fine.finish();
+
+    while (std::min(levels.back().nx, levels.back().ny) > coarsestSize) {
+      levels.emplace_back();
+      coarsen(levels[levels.size() - 2], levels.back());
+    }
+  }
+
+  // Solves A x = b starting from x, until max |r| <= tolerance or after
+  // maxIters iterations. b and x are full grids; entries outside the fluid
+  // are ignored and x is left zero there.
+  Result solve(const T* b, T* x, T tolerance, int maxIters)
+  {
+    const auto tol = static_cast<double>(tolerance);
+    auto& fine = levels[0];
+    const auto size = fine.fluid.size();
+    r.assign(size, T(0));
+    z.assign(size, T(0));
+    d.assign(size, T(0));
+    q.assign(size, T(0));
+
+    for (auto c = 0UL; c < size; c++) {
+      if (!fine.fluid[c]) {
+        x[c] = T(0);
+      }
+    }
+    fine.apply(x, q.data());
+    for (auto c = 0UL; c < size; c++) {
+      r[c] = fine.fluid[c] ? b[c] - q[c] : T(0);
+    }
+
+    Result result {0, maxAbs(r)};
+    if (result.residual <= tol) {
+      return result;
+    }
+
+    precondition(r, z);
+    d = z;
+    double rz = dot(r, z);
+
+    while (result.iterations < maxIters) {
+      fine.apply(d.data(), q.data());
+      const double dq = dot(d, q);
+      if (!(dq > 0.0)) {
+        break;
+      }
+      const auto alpha = static_cast<T>(rz / dq);
+      for (auto c = 0UL; c < size; c++) {
+        x[c] += alpha * d[c];
+        r[c] -= alpha * q[c];
+      }
+      result.iterations++;
+      result.residual = maxAbs(r);
+      if (result.residual <= tol) {
+        break;
+      }
+
+      precondition(r, z);
+      const double rzNew = dot(r, z);
+      const auto beta = static_cast<T>(rzNew / rz);
+      rz = rzNew;
+      for (auto c = 0UL; c < size; c++) {
+        d[c] = z[c] + beta * d[c];
+      }
+    }
+    return result;
+  }
+
+  // coarsening stops once a level is this small in either direction
+  static constexpr std::size_t coarsestSize = 8;
+  static constexpr int smoothingSweeps = 2;
+  static constexpr int coarsestSweeps = 16;
+
+private:
+  struct Level
+  {
+    std::size_t nx {0}, ny {0};
+    std::vector<char> fluid;
+    std::vector<char> air;
+    // wx[c] is the face between cells c - ny and c, wy[c] the one between
+    // c - 1 and c; 0 closes the face
+    std::vector<T> wx, wy;
+    std::vector<T> diag;
+    std::vector<T> x, b;
+
+    void resize(std::size_t w, std::size_t h)
+    {
+      nx = w;
+      ny = h;
+      fluid.assign(w * h, 0);
+      air.assign(w * h, 0);
+      wx.assign(w * h, T(0));
+      wy.assign(w * h, T(0));
+      diag.assign(w * h, T(0));
+      x.assign(w * h, T(0));
+      b.assign(w * h, T(0));
+    }
+
+    void finish()
+    {
+      for (auto c = 0UL; c < fluid.size(); c++) {
+        if (fluid[c]) {
+          diag[c] = wx[c] + wx[c + ny] + wy[c] + wy[c + 1];
+          // nothing couples it to the rest, leave it out
+          fluid[c] = diag[c] > T(0);
+        }
+      }
+    }
+
+    T neighbours(const T* v, std::size_t c) const
+    {
+      return wx[c] * v[c - ny] + wx[c + ny] * v[c + ny] + wy[c] * v[c - 1]
+          + wy[c + 1] * v[c + 1];
+    }
+
+    void apply(const T* v, T* out) const
+    {
+      for (auto c = 0UL; c < fluid.size(); c++) {
+        out[c] = fluid[c] ? diag[c] * v[c] - neighbours(v, c) : T(0);
+      }
+    }
+
+    // One Gauss-Seidel pass over the cells with (i + j) % 2 == color
+    void smooth(int color)
+    {
+      const auto parity = static_cast<std::size_t>(color);
+      for (auto i = 1UL; i + 1 < nx; i++) {
+        for (auto j = 1 + ((i + 1 + parity) & 1); j + 1 < ny; j += 2) {
+          const auto c = i * ny + j;
+          if (fluid[c]) {
+            x[c] = (b[c] + neighbours(x.data(), c)) / diag[c];
+          }
+        }
+      }
+    }
+  };
+
+  // Fine cells 2I - 1 and 2I fold into coarse cell I, so the border ring of
+  // the fine level lands in the border ring of the coarse one. A coarse cell
+  // with any AIR child is AIR itself: keeping the free surface on every level
+  // is what keeps splashes and thin sheets from stalling the iteration.
+  static void coarsen(const Level& fine, Level& coarse)
+  {
+    coarse.resize((fine.nx + 1) / 2 + 1, (fine.ny + 1) / 2 + 1);
+    const auto ny = fine.ny;
+    for (auto i = 0UL; i < fine.nx; i++) {
+      for (auto j = 0UL; j < ny; j++) {
+        const auto cc = ((i + 1) / 2) * coarse.ny + (j + 1) / 2;
+        const auto c = i * ny + j;
+        coarse.air[cc] = coarse.air[cc] || fine.air[c];
+        coarse.fluid[cc] = coarse.fluid[cc] || fine.fluid[c];
+        // fine faces on the coarse cell boundary, averaged over the two
+        if (i % 2 == 1) {
+          coarse.wx[cc] += T(0.5) * fine.wx[c];
+        }
+        if (j % 2 == 1) {
+          coarse.wy[cc] += T(0.5) * fine.wy[c];
+        }
+      }
+    }
+    for (auto c = 0UL; c < coarse.fluid.size(); c++) {
+      coarse.fluid[c] = coarse.fluid[c] && !coarse.air[c];
+    }
+    coarse.finish();
+  }
+
+  // z = M^-1 r with one V-cycle. Smoothing runs red then black on the way
+  // down and black then red on the way up, which keeps M symmetric.
+  void precondition(const std::vector<T>& res, std::vector<T>& out)
+  {
+    std::copy(res.begin(), res.end(), levels[0].b.begin());
+    for (auto l = 0UL; l < levels.size(); l++) {
+      auto& level = levels[l];
+      std::fill(level.x.begin(), level.x.end(), T(0));
+      const bool coarsest = l + 1 == levels.size();
+      const int sweeps = coarsest ? coarsestSweeps : smoothingSweeps;
+      for (auto k = 0; k < sweeps; k++) {
+        level.smooth(0);
+        level.smooth(1);
+      }
+      if (coarsest) {
+        for (auto k = 0; k < sweeps; k++) {
+          level.smooth(1);
+          level.smooth(0);
+        }
+        break;
+      }
+      restrictResidual(level, levels[l + 1]);
+    }
+
+    for (auto l = levels.size() - 1; l-- > 0;) {
+      auto& level = levels[l];
+      prolongate(levels[l + 1], level);
+      for (auto k = 0; k < smoothingSweeps; k++) {
+        level.smooth(1);
+        level.smooth(0);
+      }
+    }
+    std::copy(levels[0].x.begin(), levels[0].x.end(), out.begin());
+  }
+
+  void restrictResidual(Level& fine, Level& coarse)
+  {
+    std::fill(coarse.b.begin(), coarse.b.end(), T(0));
+    const auto ny = fine.ny;
+    for (auto i = 1UL; i + 1 < fine.nx; i++) {
+      for (auto j = 1UL; j + 1 < ny; j++) {
+        const auto c = i * ny + j;
+        if (fine.fluid[c]) {
+          const auto res = fine.b[c] - fine.diag[c] * fine.x[c]
+              + fine.neighbours(fine.x.data(), c);
+          coarse.b[((i + 1) / 2) * coarse.ny + (j + 1) / 2] += res;
+        }
+      }
+    }
+    for (auto c = 0UL; c < coarse.b.size(); c++) {
+      if (!coarse.fluid[c]) {
+        coarse.b[c] = T(0);
+      }
+    }
+  }
+
+  static void prolongate(const Level& coarse, Level& fine)
+  {
+    const auto ny = fine.ny;
+    for (auto i = 1UL; i + 1 < fine.nx; i++) {
+      for (auto j = 1UL; j + 1 < ny; j++) {
+        const auto c = i * ny + j;
+        if (fine.fluid[c]) {
+          fine.x[c] += coarse.x[((i + 1) / 2) * coarse.ny + (j + 1) / 2];
+        }
+      }
+    }
+  }
+
+  static double dot(const std::vector<T>& a, const std::vector<T>& b)
+  {
+    double sum = 0.0;
+    for (auto c = 0UL; c < a.size(); c++) {
+      sum += static_cast<double>(a[c]) * static_cast<double>(b[c]);
+    }
+    return sum;
+  }
+
+  static T maxAbs(const std::vector<T>& a)
+  {
+    T m = 0;
+    for (auto v : a) {
+      m = std::max(m, std::abs(v));
+    }
+    return m;
+  }
+
+  std::vector<Level> levels;
+  std::vector<T> r, z, d, q;
+};
+}  // namespace sim
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <flip/active_blocks.hpp>
+#include <flip/kernels.hpp>
+
+namespace sim
+{
+// A solid shape in the tank. The shape is given around the origin and placed
+// at (x, y); it moves with (vx, vy), which the grid faces and the particles
+// it touches take on.
+template<typename T>
+struct Obstacle
+{
+  enum Shape
+  {
+    CIRCLE,
+    // axis aligned, halfWidth and halfHeight either side of the origin
+    BOX,
+    // vertices in order around a simple polygon, either winding
+    POLYGON
+  };
+
+  static Obstacle circle(T radius)
+  {
+    Obstacle o;
+    o.shape = CIRCLE;
+    o.radius = radius;
+    return o;
+  }
+
+  static Obstacle box(T halfWidth, T halfHeight)
+  {
+    Obstacle o;
+    o.shape = BOX;
+    o.halfWidth = halfWidth;
+    o.halfHeight = halfHeight;
+    return o;
+  }
+
+  static Obstacle polygon(std::vector<T> xs, std::vector<T> ys)
+  {
+    Obstacle o;
+    o.shape = POLYGON;
+    o.vertexX = std::move(xs);
+    o.vertexY = std::move(ys);
+    return o;
+  }
+
+  // Signed distance from (px, py) to the surface, negative inside, and the
+  // outward normal (nx, ny) at the closest surface point
+  T distance(T px, T py, T& nx, T& ny) const
+  {
+    const T qx = px - x;
+    const T qy = py - y;
+    nx = 0;
+    ny = 1;
+    switch (shape) {
+      case CIRCLE:
+        return circleDistance(qx, qy, nx, ny);
+      case BOX:
+        return boxDistance(qx, qy, nx, ny);
+      case POLYGON:
+        return polygonDistance(qx, qy, nx, ny);
+    }
+    return std::numeric_limits<T>::max();
+  }
+
+  T distance(T px, T py) const
+  {
+    T nx;
+    T ny;
+    return distance(px, py, nx, ny);
+  }
+
+  // box [x0, x1] x [y0, y1] around the shape
+  struct Bounds
+  {
+    T x0, y0, x1, y1;
+  };
+
+  Bounds bounds() const
+  {
+    Bounds b {-radius, -radius, radius, radius};
+    if (shape == BOX) {
+      b = {-halfWidth, -halfHeight, halfWidth, halfHeight};
+    } else if (shape == POLYGON) {
+      const auto [x0, x1] =
+          std::minmax_element(vertexX.begin(), vertexX.end());
+      const auto [y0, y1] =
+          std::minmax_element(vertexY.begin(), vertexY.end());
+      b = {*x0, *y0, *x1, *y1};
+    }
+    return {b.x0 + x, b.y0 + y, b.x1 + x, b.y1 + y};
+  }
+
+  Shape shape {CIRCLE};
+  T x {0}, y {0};
+  T vx {0}, vy {0};
+  T radius {0};
+  T halfWidth {0}, halfHeight {0};
+  std::vector<T> vertexX, vertexY;
+
+private:
+  T circleDistance(T qx, T qy, T& nx, T& ny) const
+  {
+    const T d = std::hypot(qx, qy);
+    nx = 0;
+    ny = 1;
+    if (d > std::numeric_limits<T>::min()) {
+      nx = qx / d;
+      ny = qy / d;
+    }
+    return d - radius;
+  }
+
+  T boxDistance(T qx, T qy, T& nx, T& ny) const
+  {
+    const T sx = qx < T(0) ? T(-1) : T(1);
+    const T sy = qy < T(0) ? T(-1) : T(1);
+    const T dx = std::abs(qx) - halfWidth;
+    const T dy = std::abs(qy) - halfHeight;
+    if (dx > T(0) || dy > T(0)) {
+      const T ox = std::max(dx, T(0));
+      const T oy = std::max(dy, T(0));
+      const T d = std::hypot(ox, oy);
+      nx = sx * ox / d;
+      ny = sy * oy / d;
+      return d;
+    }
+    // inside, out through the nearest side
+    if (dx > dy) {
+      nx = sx;
+      ny = 0;
+      return dx;
+    }
+    nx = 0;
+    ny = sy;
+    return dy;
+  }
+
+  T polygonDistance(T qx, T qy, T& nx, T& ny) const
+  {
+    const auto count = vertexX.size();
+    T best = std::numeric_limits<T>::max();
+    T bx = 0;
+    T by = 1;
+    bool inside = false;
+    for (auto i = 0UL, j = count - 1; i < count; j = i++) {
+      const T ax = vertexX[j];
+      const T ay = vertexY[j];
+      const T ex = vertexX[i] - ax;
+      const T ey = vertexY[i] - ay;
+      const T wx = qx - ax;
+      const T wy = qy - ay;
+
+      // closest point of the edge
+      const T len2 = ex * ex + ey * ey;
+      T t = 0;
+      if (len2 > std::numeric_limits<T>::min()) {
+        t = std::clamp((wx * ex + wy * ey) / len2, T(0), T(1));
+      }
+      const T dx = wx - ex * t;
+      const T dy = wy - ey * t;
+      const T d2 = dx * dx + dy * dy;
+      if (d2 < best) {
+        best = d2;
+        bx = dx;
+        by = dy;
+      }
+
+      // even-odd crossings of a ray towards +x
+      if ((ay > qy) != (vertexY[i] > qy) && qx < ax + wy * ex / ey) {
+        inside = !inside;
+      }
+    }
+
+    const T d = std::sqrt(best);
+    nx = 0;
+    ny = 1;
+    if (d > std::numeric_limits<T>::min()) {
+      nx = bx / d;
+      ny = by / d;
+    }
+    if (inside) {
+      nx = -nx;
+      ny = -ny;
+      return -d;
+    }
+    return d;
+  }
+};
+
+// The obstacles of a grid of numX x numY cells of size h, rasterized into
+// the solid fraction s of the grid: an interior cell whose center is inside
+// an obstacle is solid, and remembers which obstacle it belongs to so its
+// faces can take that obstacle's velocity. rasterize() only redoes the
+// obstacles that moved, clearing the cells they left and filling the ones
+// they moved into. Shapes are fixed once rasterized, only x, y, vx and vy
+// may change. The tank walls are never touched.
+template<typename T>
+class ObstacleSet
+{
+public:
+  void init(int cellsX, int cellsY, T spacing)
+  {
+    numX = cellsX;
+    numY = cellsY;
+    h = spacing;
+    owner.assign(static_cast<std::size_t>(numX * numY), -1);
+    list.clear();
+    footprints.clear();
+    placements.clear();
+  }
+
+  // Returns the index of the obstacle in list
+  int add(Obstacle<T> obstacle)
+  {
+    list.push_back(std::move(obstacle));
+    return static_cast<int>(list.size()) - 1;
+  }
+
+  // Updates s and cellType of the cells the obstacles that moved since the
+  // last call left or entered, and touches their blocks for recoloring
+  void rasterize(std::vector<T>& s,
+                 std::vector<CellType>& cellType,
+                 ActiveBlocks& blocks)
+  {
+    footprints.resize(list.size());
+    placements.resize(list.size());
+
+    moved.clear();
+    for (auto k = 0UL; k < list.size(); k++) {
+      const auto& p = placements[k];
+      if (!p.placed || std::abs(list[k].x - p.x) > T(0)
+          || std::abs(list[k].y - p.y) > T(0))
+      {
+        moved.push_back(k);
+      }
+    }
+    if (moved.empty()) {
+      return;
+    }
+
+    // give up the old cells first, so obstacles can move into each other's
+    vacated.clear();
+    for (const auto k : moved) {
+      for (const auto c : footprints[k]) {
+        if (owner[c] == static_cast<int>(k)) {
+          owner[c] = -1;
+          vacated.push_back(c);
+        }
+      }
+    }
+
+    for (const auto k : moved) {
+      auto& cells = footprints[k];
+      cells.clear();
+      forCellsInside(k,
+                     [&](std::size_t c)
+                     {
+                       cells.push_back(c);
+                       owner[c] = static_cast<int>(k);
+                       s[c] = T(0);
+                       cellType[c] = CellType::SOLID;
+                       touch(blocks, c);
+                     });
+      placements[k] = {list[k].x, list[k].y, true};
+    }
+
+    // a cell left by one obstacle may still be inside one that overlaps it
+    for (const auto c : vacated) {
+      if (owner[c] != -1) {
+        continue;
+      }
+      owner[c] = findOwner(c);
+      if (owner[c] == -1) {
+        s[c] = T(1);
+        cellType[c] = CellType::AIR;
+        touch(blocks, c);
+      }
+    }
+  }
+
+  // obstacle cell c belongs to, nullptr when it is not inside one
+  const Obstacle<T>* at(std::size_t c) const
+  {
+    return owner[c] < 0 ? nullptr
+                        : &list[static_cast<std::size_t>(owner[c])];
+  }
+
+  // fastest obstacle speed
+  T maxSpeed() const
+  {
+    T speed = 0;
+    for (const auto& o : list) {
+      speed = std::max(speed, std::hypot(o.vx, o.vy));
+    }
+    return speed;
+  }
+
+  std::vector<Obstacle<T>> list;
+
+private:
+  // Calls f(c) for the interior cells whose center is inside obstacle k
+  template<typename F>
+  void forCellsInside(std::size_t k, F&& f) const
+  {
+    const auto& o = list[k];
+    const auto b = o.bounds();
+    const T invH = T(1) / h;
+    const auto i0 = std::max(1, static_cast<int>(std::floor(b.x0 * invH)));
+    const auto i1 =
+        std::min(numX - 2, static_cast<int>(std::floor(b.x1 * invH)));
+    const auto j0 = std::max(1, static_cast<int>(std::floor(b.y0 * invH)));
+    const auto j1 =
+        std::min(numY - 2, static_cast<int>(std::floor(b.y1 * invH)));
+    for (auto i = i0; i <= i1; i++) {
+      for (auto j = j0; j <= j1; j++) {
+        if (o.distance((T(i) + T(0.5)) * h, (T(j) + T(0.5)) * h) < T(0)) {
+          f(static_cast<std::size_t>(i * numY + j));
+        }
+      }
+    }
+  }
+
+  int findOwner(std::size_t c) const
+  {
+    const auto i = static_cast<int>(c) / numY;
+    const auto j = static_cast<int>(c) % numY;
+    const T cx = (T(i) + T(0.5)) * h;
+    const T cy = (T(j) + T(0.5)) * h;
+    for (auto k = 0UL; k < list.size(); k++) {
+      const auto b = list[k].bounds();
+      if (cx >= b.x0 && cx <= b.x1 && cy >= b.y0 && cy <= b.y1
+          && list[k].distance(cx, cy) < T(0))
+      {
+        return static_cast<int>(k);
+      }
+    }
+    return -1;
+  }
+
+  void touch(ActiveBlocks& blocks, std::size_t c) const
+  {
+    blocks.touch(static_cast<int>(c) / numY, static_cast<int>(c) % numY);
+  }
+
+  // where an obstacle was when last rasterized
+  struct Placement
+  {
+    T x {0}, y {0};
+    // false until the obstacle is rasterized the first time
+    bool placed {false};
+  };
+
+  int numX {0}, numY {0};
+  T h {1};
+  // obstacle each cell is inside, -1 for none
+  std::vector<int> owner;
+  // cells each obstacle covered when last rasterized, and where it was
+  std::vector<std::vector<std::size_t>> footprints;
+  std::vector<Placement> placements;
+  std::vector<std::size_t> moved;
+  std::vector<std::size_t> vacated;
+};
+}  // namespace sim
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace sim
+{
+// Hands out storage aligned to Align bytes, so every column starts on a cache
+// line and vector loads from the start of a column never split one.
+template<typename T, std::size_t Align = 64>
+struct AlignedAllocator
+{
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = AlignedAllocator<U, Align>;
+  };
+
+  AlignedAllocator() = default;
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Align>&)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t {Align}));
+  }
+  void deallocate(T* p, std::size_t)
+  {
+    ::operator delete(p, std::align_val_t {Align});
+  }
+
+  friend bool operator==(const AlignedAllocator&, const AlignedAllocator&)
+  {
+    return true;
+  }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// One aligned column per particle field, index i across all columns is one
+// particle.
+template<typename T>
+struct ParticleColumns
+{
+  AlignedVector<T> x, y;
+  AlignedVector<T> vx, vy;
+
+  std::size_t size() const { return x.size(); }
+  void resize(std::size_t n)
+  {
+    for (auto* col : {&x, &y, &vx, &vy}) {
+      col->assign(n, T(0));
+    }
+  }
+};
+
+// Z-order (Morton) code of a 2D cell: the bits of x and y interleaved, x in
+// the even bits. Cells close in 2D mostly get close codes.
+inline std::uint64_t mortonCode(std::uint32_t x, std::uint32_t y)
+{
+  auto spread = [](std::uint64_t v)
+  {
+    v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    v = (v | (v << 2)) & 0x3333333333333333ULL;
+    v = (v | (v << 1)) & 0x5555555555555555ULL;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+}  // namespace sim
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <engine/triple_buffer.hpp>
+
+namespace sim
+{
+// Steps a fluid on its own thread, one simulate() every scene.dt of wall
+// time, and publishes every finished step as a Frame. The renderer picks up
+// the newest frame without waiting and hands the mouse over as Input, so a
+// slow step never stalls drawing and vsync never throttles the sim. Once
+// start()ed the fluid belongs to the thread until the SimulationThread is
+// destroyed.
+template<typename Fluid>
+class SimulationThread
+{
+public:
+  using T = typename Fluid::Scalar;
+
+  struct Frame
+  {
+    std::vector<typename Fluid::Color> cellColor;
+    std::vector<T> particleX, particleY;
+    T obstacleX {0};
+    T obstacleY {0};
+    typename Fluid::PressureStats pressureStats {0, 0.0};
+    int subSteps {1};
+    std::uint64_t step {0};
+  };
+
+  struct Input
+  {
+    T obstacleX {0};
+    T obstacleY {0};
+    bool dragging {false};
+    bool paused {true};
+    // bumped on every grab; the first step that sees a new value places the
+    // obstacle without giving it a velocity
+    std::uint32_t grabs {0};
+  };
+
+  explicit SimulationThread(Fluid& simulated)
+      : fluid(simulated)
+  {
+  }
+
+  // Publishes the current state and starts stepping
+  void start()
+  {
+    fluid.simulate();
+    publish();
+    thread = std::jthread([this](std::stop_token stop) { run(stop); });
+  }
+
+  // renderer side
+
+  void post(const Input& in)
+  {
+    inputs.write_buffer() = in;
+    inputs.publish();
+  }
+
+  // Latest complete frame; update() first to pick up a newer one
+  bool update() { return frames.update(); }
+  const Frame& frame() const { return frames.read_buffer(); }
+
+private:
+  void run(const std::stop_token& stop)
+  {
+    using clock = std::chrono::steady_clock;
+    const auto step = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(fluid.scene.dt));
+
+    auto next = clock::now();
+    while (!stop.stop_requested()) {
+      applyInput();
+      if (!input.paused) {
+        fluid.simulate();
+        publish();
+      }
+
+      // a step that ran long is not made up for, the sim just falls behind
+      // wall time instead of piling up steps
+      next = std::max(next + step, clock::now());
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  void applyInput()
+  {
+    const bool wasDragging = input.dragging;
+    const auto grabs = input.grabs;
+    if (inputs.update()) {
+      input = inputs.read_buffer();
+    }
+
+    if (input.grabs != grabs) {
+      fluid.setObstacle(input.obstacleX, input.obstacleY, true);
+    } else if (input.dragging) {
+      fluid.setObstacle(input.obstacleX, input.obstacleY, false);
+    } else if (wasDragging) {
+      fluid.scene.obstacleVelX = 0;
+      fluid.scene.obstacleVelY = 0;
+    }
+  }
+
+  void publish()
+  {
+    auto& out = frames.write_buffer();
+    // assign() reuses the capacity of the frame this buffer held before
+    out.cellColor.assign(fluid.cellColor.begin(), fluid.cellColor.end());
+    out.particleX.assign(fluid.particles.x.begin(),
+                         fluid.particles.x.begin() + fluid.numParticles);
+    out.particleY.assign(fluid.particles.y.begin(),
+                         fluid.particles.y.begin() + fluid.numParticles);
+    out.obstacleX = fluid.scene.obstacleX;
+    out.obstacleY = fluid.scene.obstacleY;
+    out.pressureStats = fluid.pressureStats;
+    out.subSteps = fluid.subSteps;
+    out.step = ++steps;
+    frames.publish();
+  }
+
+  Fluid& fluid;
+  engine::TripleBuffer<Frame> frames;
+  engine::TripleBuffer<Input> inputs;
+  // the last input the sim thread applied
+  Input input;
+  std::uint64_t steps {0};
+  // declared last so it stops before anything it uses goes away
+  std::jthread thread;
+};
+}  // namespace sim
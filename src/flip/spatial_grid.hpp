@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace sim
+{
+// Uniform grid that bins particles by position. build() caches the cell of
+// every particle and groups the particle ids cell by cell, so later passes in
+// the same substep can ask for the particles around a cell without touching
+// the positions again. Cells are stored column by column, numY per column.
+template<typename T>
+class SpatialGrid
+{
+public:
+  void init(T width, T height, T spacing, std::size_t capacity)
+  {
+    invSpacing = T(1) / spacing;
+    numX = static_cast<int>(std::floor(width * invSpacing)) + 1;
+    numY = static_cast<int>(std::floor(height * invSpacing)) + 1;
+    numCells = numX * numY;
+
+    cellStart.assign(static_cast<std::size_t>(numCells) + 1, 0);
+    particleCells.assign(capacity, 0);
+    cellParticles.assign(capacity, 0);
+  }
+
+  // cell of a position, clamped to the grid
+  int cellOf(T x, T y) const
+  {
+    const int xi = std::clamp(
+        static_cast<int>(std::floor(x * invSpacing)), 0, numX - 1);
+    const int yi = std::clamp(
+        static_cast<int>(std::floor(y * invSpacing)), 0, numY - 1);
+    return xi * numY + yi;
+  }
+
+  int cellX(int cell) const { return cell / numY; }
+  int cellY(int cell) const { return cell % numY; }
+
+  // Bins particles [0, count). Within a cell the ids stay in ascending order.
+  void build(const T* x, const T* y, std::size_t count)
+  {
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (auto i = 0UL; i < count; i++) {
+      const auto cell = cellOf(x[i], y[i]);
+      particleCells[i] = cell;
+      cellStart[static_cast<std::size_t>(cell) + 1]++;
+    }
+    for (auto c = 1UL; c < cellStart.size(); c++) {
+      cellStart[c] += cellStart[c - 1];
+    }
+
+    // cellStart[c] runs ahead while filling and ends at the start of c + 1
+    for (auto i = 0UL; i < count; i++) {
+      const auto cell = static_cast<std::size_t>(particleCells[i]);
+      cellParticles[static_cast<std::size_t>(cellStart[cell]++)] =
+          static_cast<int>(i);
+    }
+    for (auto c = cellStart.size() - 1; c > 0; c--) {
+      cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+  }
+
+  // cell particle i was binned in by the last build()
+  int cellOfParticle(std::size_t i) const { return particleCells[i]; }
+
+  std::span<const int> particlesIn(int cell) const
+  {
+    const auto c = static_cast<std::size_t>(cell);
+    const auto first = static_cast<std::size_t>(cellStart[c]);
+    const auto last = static_cast<std::size_t>(cellStart[c + 1]);
+    return {cellParticles.data() + first, last - first};
+  }
+
+  // Calls f(id) for every particle binned in the cells [x0, x1] x [y0, y1],
+  // the range clamped to the grid
+  template<typename F>
+  void forEachInCells(int x0, int y0, int x1, int y1, F&& f) const
+  {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, numX - 1);
+    y1 = std::min(y1, numY - 1);
+    for (auto xi = x0; xi <= x1; xi++) {
+      for (auto yi = y0; yi <= y1; yi++) {
+        for (const auto id : particlesIn(xi * numY + yi)) {
+          f(id);
+        }
+      }
+    }
+  }
+
+  // Calls f(id) for every particle binned in cell or the 8 cells around it
+  template<typename F>
+  void forEachNear(int cell, F&& f) const
+  {
+    const auto xi = cellX(cell);
+    const auto yi = cellY(cell);
+    forEachInCells(xi - 1, yi - 1, xi + 1, yi + 1, std::forward<F>(f));
+  }
+
+  T invSpacing {1};
+  int numX {0}, numY {0};
+  int numCells {0};
+
+private:
+  // start of each cell's run in cellParticles, numCells + 1 entries
+  std::vector<int> cellStart;
+  std::vector<int> particleCells;
+  std::vector<int> cellParticles;
+};
+}  // namespace sim
@@ -1,12 +1,21 @@
 #include <algorithm>
 #include <array>
 #include <bit>
+#include <charconv>
+#include <chrono>
 #include <cstddef>
 #include <cstdlib>
 #include <ctime>
 #include <format>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
 // sdl headers
@@ -27,26 +36,52 @@
 #include <SDL3_ttf/SDL_ttf.h>
 
 // engine header
+#include <backend/SDL3/font.hpp>
+#include <backend/SDL3/render.hpp>
+#include <backend/SDL3/text.hpp>
+#include <backend/software/frame_sink.hpp>
+#include <backend/software/raster.hpp>
+#include <backend/software/tiler.hpp>
+#include <engine/arena.hpp>
 #include <engine/command.hpp>
+#include <engine/command_buffer.hpp>
+#include <engine/engine.hpp>
+#include <engine/font.hpp>
+#include <engine/thread_pool.hpp>
 #include <flip/flip.hpp>
+#include <flip/sim_thread.hpp>
 
 using engine::Command;
 using engine::CommandType;
 using engine::RectCommand;
 using engine::TextCommand;
 
-#define BUF_SIZE (1024UL * 1024UL * sizeof(engine::RectCommand))
+// the interactive sim runs in single precision, FlipFluid<double> is the
+// reference to check it against
+using Fluid = sim::FlipFluid<float>;
+using Simulation = sim::SimulationThread<Fluid>;
+
+// initial command storage, the arena chains heap chunks beyond this
+#define BUF_SIZE (16UL * 1024UL * sizeof(engine::RectCommand))
 alignas(engine::RectCommand) static std::array<std::byte, BUF_SIZE> cmdbuf {};
-static std::size_t cmdidx = 0;
 
 namespace
 {
-void draw_grid(unsigned int size_x,
+// pixels per grid cell that fit the whole grid in width x height
+auto grid_scale(int width, int height, const Fluid& flip) -> double
+{
+  constexpr auto padding = 15.0;
+  return std::min((static_cast<double>(width) - padding) / flip.fNumX,
+                  (static_cast<double>(height) - padding) / flip.fNumY);
+}
+
+void draw_grid(engine::CommandBuffer& cmds,
+               unsigned int size_x,
                unsigned int size_y,
                unsigned int width,
                unsigned int height,
                float scale,
-               const std::vector<sim::FlipFluid::Color>& colors)
+               const std::vector<Fluid::Color>& colors)
 {
   const float offsetx = ((static_cast<float>(width) / 2.0F)
                          - (static_cast<float>(size_x) * scale / 2.0F));
@@ -59,21 +94,48 @@ void draw_grid(unsigned int size_x,
       const auto cred = colors[fixedidx].r;
       const auto cgreen = colors[fixedidx].g;
       const auto cblue = colors[fixedidx].b;
-      cmdidx =
-          engine::RectCommand::push({(static_cast<float>(i) * scale) + offsetx,
-                                     (static_cast<float>(j) * scale) + offsety,
-                                     (1.0F) * (scale - 1.0F),
-                                     (1.0F) * (scale - 1.0F)},
-                                    {static_cast<float>(cred),
-                                     static_cast<float>(cgreen),
-                                     static_cast<float>(cblue),
-                                     1},
-                                    (char*)cmdbuf.data(),
-                                    cmdidx);
+      cmds.push_rect({(static_cast<float>(i) * scale) + offsetx,
+                      (static_cast<float>(j) * scale) + offsety,
+                      (1.0F) * (scale - 1.0F),
+                      (1.0F) * (scale - 1.0F)},
+                     {static_cast<float>(cred),
+                      static_cast<float>(cgreen),
+                      static_cast<float>(cblue),
+                      1});
     }
   }
 }
 
+// obstacle outline drawn over the frame, in window pixels
+struct Circle
+{
+  int x;
+  int y;
+  int radius;
+
+  bool operator==(const Circle&) const = default;
+};
+
+// Appends the fields that decide how a text command looks to out, so two
+// overlays draw the same when their strings are equal. The raw record is not
+// used, its padding is never written.
+void append_overlay(std::string& out, const TextCommand& tc)
+{
+  const std::array<float, 8> box_color {tc.bbox.x(),
+                                        tc.bbox.y(),
+                                        tc.bbox.z(),
+                                        tc.bbox.w(),
+                                        tc.c.x(),
+                                        tc.c.y(),
+                                        tc.c.z(),
+                                        tc.c.w()};
+  out.append(reinterpret_cast<const char*>(box_color.data()),
+             sizeof(box_color));
+  out.append(reinterpret_cast<const char*>(&tc.font), sizeof(tc.font));
+  out.append(reinterpret_cast<const char*>(&tc.nchar), sizeof(tc.nchar));
+  out.append(std::string_view(tc.text, tc.nchar));
+}
+
 void set_pixel(SDL_Renderer* rend,
                int posx,
                int posy,
@@ -189,10 +251,184 @@ void draw_circle(SDL_Renderer* surface,
     */
   }
 }
+
+// --headless [--frames N] [--size WxH] [--res N] [--ppm PATH | --raw PATH]
+struct HeadlessOptions
+{
+  int frames {600};
+  int width {480};
+  int height {480};
+  // grid cells across the tank height
+  int res {64};
+  // where to stream the frames, "-" for stdout; nothing is written if empty
+  std::string out;
+  backend::FrameSink::Format format {backend::FrameSink::Format::PPM};
+};
+
+auto parse_int(std::string_view text, int& value) -> bool
+{
+  const auto* end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  return ec == std::errc {} && ptr == end && value > 0;
+}
+
+// Reads the options of a headless run, false on anything it does not know
+auto parse_headless(std::span<char*> args, HeadlessOptions& opts) -> bool
+{
+  for (auto i = 1UL; i < args.size(); i++) {
+    const std::string_view arg = args[i];
+    if (arg == "--headless") {
+      continue;
+    }
+    if (i + 1 == args.size()) {
+      return false;
+    }
+    const std::string_view value = args[++i];
+    bool ok = true;
+    if (arg == "--frames") {
+      ok = parse_int(value, opts.frames);
+    } else if (arg == "--res") {
+      ok = parse_int(value, opts.res);
+    } else if (arg == "--size") {
+      const auto x = value.find('x');
+      ok = x != std::string_view::npos
+          && parse_int(value.substr(0, x), opts.width)
+          && parse_int(value.substr(x + 1), opts.height);
+    } else if (arg == "--ppm" || arg == "--raw") {
+      opts.out = value;
+      opts.format = arg == "--ppm" ? backend::FrameSink::Format::PPM
+                                   : backend::FrameSink::Format::RAW;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Steps the sim and renders every frame in software, as fast as they go and
+// without a window, then reports how long each stage took
+auto run_headless(const HeadlessOptions& opts) -> int
+{
+  using clock = std::chrono::steady_clock;
+  using ms = std::chrono::duration<double, std::milli>;
+
+  // the frames may go to stdout, so the reports go to stderr then
+  auto& log = opts.out == "-" ? std::cerr : std::cout;
+
+  std::unique_ptr<backend::FrameSink> sink;
+  if (!opts.out.empty()) {
+    sink = std::make_unique<backend::FrameSink>(opts.out, opts.format);
+    if (!sink->ok()) {
+      std::cerr << "Could not open " << opts.out << " for writing\n";
+      return 1;
+    }
+  }
+
+  Fluid flip {static_cast<float>(opts.width),
+              static_cast<float>(opts.height),
+              opts.res};
+  // sim and rendering take turns, so they share one pool
+  engine::ThreadPool pool {std::max(1U, std::thread::hardware_concurrency())};
+  flip.setThreadPool(&pool);
+  flip.scene.pressureSolver = Fluid::RED_BLACK;
+
+  const engine::Dimensions dims {static_cast<std::size_t>(opts.width),
+                                 static_cast<std::size_t>(opts.height)};
+  engine::Arena arena {cmdbuf.data(),
+                      cmdbuf.size(),
+                      std::pmr::new_delete_resource()};
+  engine::Engine eng {arena, dims};
+  backend::TileRenderer tiles {pool};
+  std::vector<std::uint32_t> pixels(dims.x() * dims.y());
+  backend::Framebuffer framebuffer {
+      pixels.data(), opts.width, opts.height, opts.width};
+  const auto scale = static_cast<float>(
+      grid_scale(opts.width, opts.height, flip));
+
+  ms sim_time {};
+  ms render_time {};
+  ms write_time {};
+  long substeps = 0;
+  constexpr auto report_every = 100;
+  const auto start = clock::now();
+  auto window_start = start;
+  log << std::fixed << std::setprecision(2);
+
+  for (auto frame = 1; frame <= opts.frames; frame++) {
+    const auto t0 = clock::now();
+    flip.simulate();
+    substeps += flip.subSteps;
+
+    const auto t1 = clock::now();
+    eng.begin(dims);
+    draw_grid(eng.commands(),
+              static_cast<unsigned int>(flip.fNumX),
+              static_cast<unsigned int>(flip.fNumY),
+              static_cast<unsigned int>(opts.width),
+              static_cast<unsigned int>(opts.height),
+              scale,
+              flip.cellColor);
+    tiles.render(
+        framebuffer, backend::Software_PackColor({0, 0, 0, 1}), eng.end());
+
+    const auto t2 = clock::now();
+    if (sink && !sink->write(framebuffer)) {
+      std::cerr << "Writing frame " << frame << " to " << opts.out
+                << " failed\n";
+      return 1;
+    }
+    const auto t3 = clock::now();
+
+    sim_time += t1 - t0;
+    render_time += t2 - t1;
+    write_time += t3 - t2;
+    if (frame % report_every == 0) {
+      const ms window = t3 - window_start;
+      window_start = t3;
+      log << "frame " << frame << "/" << opts.frames << ": "
+          << report_every * 1000.0 / window.count() << " fps\n";
+    }
+  }
+
+  const ms total = clock::now() - start;
+  const auto frames = static_cast<double>(opts.frames);
+  log << opts.frames << " frames of " << flip.fNumX << "x" << flip.fNumY
+      << " cells and " << flip.numParticles << " particles at "
+      << opts.width << "x" << opts.height << " in " << total.count() / 1000.0
+      << " s: " << frames * 1000.0 / total.count() << " fps\n"
+      << "  sim    " << sim_time.count() / frames << " ms/frame, "
+      << static_cast<double>(substeps) / frames << " substeps, "
+      << static_cast<double>(flip.numParticles)
+             * static_cast<double>(substeps) / (sim_time.count() * 1000.0)
+      << " M particle steps/s\n"
+      << "  render " << render_time.count() / frames << " ms/frame\n";
+  if (sink) {
+    log << "  write  " << write_time.count() / frames << " ms/frame, "
+        << static_cast<double>(sink->bytes()) / (write_time.count() * 1000.0)
+        << " MB/s\n";
+  }
+  return 0;
+}
 }  // namespace
 
-auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
+auto main(int argc, char* argv[]) -> int
 {
+  const std::span<char*> args {argv, static_cast<std::size_t>(argc)};
+  if (std::ranges::find(args, std::string_view {"--headless"}) != args.end())
+  {
+    HeadlessOptions opts;
+    if (!parse_headless(args, opts)) {
+      std::cerr << "usage: " << args[0]
+                << " --headless [--frames N] [--size WxH] [--res N]"
+                   " [--ppm PATH | --raw PATH]\n";
+      return 1;
+    }
+    return run_headless(opts);
+  }
+
   if (!SDL_Init(SDL_INIT_VIDEO)) {
     SDL_Log("SDL_Init failed (%s)", SDL_GetError());
     return 1;
@@ -230,31 +466,79 @@ auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
   }
 
   TTF_Init();
-  TTF_Font* Sans = TTF_OpenFont("/usr/share/fonts/noto/NotoSans-Bold.ttf", 20);
-  TTF_SetFontHinting(Sans, TTF_HINTING_MONO);
-  TTF_SetFontWrapAlignment(Sans, TTF_HORIZONTAL_ALIGN_RIGHT);
+  // every font is mapped and opened once here, commands refer to it by id
+  engine::FontRegistry fonts;
+  const int sans = fonts.add("/usr/share/fonts/noto/NotoSans-Bold.ttf", 20);
+  if (sans < 0) {
+    SDL_Log("Could not map the UI font, text is disabled");
+  }
+  auto ttf = std::make_unique<backend::SDL3_Fonts>(fonts);
+  if (auto* font = ttf->get(sans); font != nullptr) {
+    TTF_SetFontHinting(font, TTF_HINTING_MONO);
+    TTF_SetFontWrapAlignment(font, TTF_HORIZONTAL_ALIGN_RIGHT);
+  }
 
-  sim::FlipFluid flip {static_cast<double>(surface->w),
-                       static_cast<double>(surface->h)};
+  Fluid flip {static_cast<float>(surface->w), static_cast<float>(surface->h)};
+
+  engine::Arena arena {cmdbuf.data(),
+                      cmdbuf.size(),
+                      std::pmr::new_delete_resource()};
+  engine::Engine eng {arena,
+                      {static_cast<std::size_t>(surface->w),
+                       static_cast<std::size_t>(surface->h)}};
+
+  // the sim steps on its own thread with its own workers, so rendering and
+  // simulation scale independently
+  const auto cores = std::max(2U, std::thread::hardware_concurrency());
+  engine::ThreadPool pool {cores / 2};
+  engine::ThreadPool sim_pool {cores - cores / 2};
+  flip.setThreadPool(&sim_pool);
+  flip.scene.pressureSolver = Fluid::RED_BLACK;
+  // owns flip from start() on; its grid size and scales never change, so
+  // the loop below still reads those from flip directly
+  Simulation simulation {flip};
+  backend::TileRenderer tiles {pool};
+  std::vector<std::uint32_t> pixels;
+  backend::Framebuffer framebuffer {};
+  SDL_Texture* texture = nullptr;
+  // what the overlay looked like in the last presented frame
+  Circle shown_circle {};
+  std::string shown_text;
+  std::string overlay_text;
+  backend::SDL3_RectBatcher batcher;
+  // owns an atlas texture, so it has to go before the renderer
+  auto text = std::make_unique<backend::SDL3_TextRenderer>(renderer);
+  for (auto id = 0; id < static_cast<int>(ttf->size()); id++) {
+    text->set_font(id, ttf->get(id));
+  }
 
   auto newtime = SDL_GetTicks();
   decltype(newtime) oldtime {};
   int framecount = 0;
   float fps {};
 
-  bool move = false;
+  Simulation::Input input;
   bool bordered = true;
-  bool paused = true;
-  flip.simulate();
+  bool gpu = false;
+  // obstacle position under the mouse, in sim units
+  auto mouse_to_sim = [&]
+  {
+    float mposx {0.0F};
+    float mposy {0.0F};
+    SDL_GetMouseState(&mposx, &mposy);
+    mposx = std::clamp(mposx, 0.0F, static_cast<float>(surface->w));
+    mposy = std::clamp(mposy, 0.0F, static_cast<float>(surface->h));
+    input.obstacleX = mposx / flip.simScale;
+    input.obstacleY =
+        (static_cast<float>(surface->h) - mposy) / flip.simScale;
+  };
+  simulation.start();
 
   while (true) {
     auto starttime = SDL_GetTicks();
     surface = SDL_GetWindowSurface(window);
 
-    constexpr auto padding = 15.0;
-    auto scale =
-        std::min((static_cast<double>(surface->w) - padding) / flip.fNumX,
-                 (static_cast<double>(surface->h) - padding) / flip.fNumY);
+    auto scale = grid_scale(surface->w, surface->h, flip);
     oldtime = newtime;
     bool finished = false;
     SDL_Event event;
@@ -263,29 +547,28 @@ auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
         finished = true;
         break;
       }
+      if (event.type == SDL_EVENT_WINDOW_EXPOSED) {
+        tiles.invalidate();
+      }
       if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
-        paused = false;
-        move = true;
-        float mposx {0.0F};
-        float mposy {0.0F};
-        SDL_GetMouseState(&mposx, &mposy);
-        mposx = std::clamp(mposx, 0.0F, static_cast<float>(surface->w));
-        mposy = std::clamp(mposy, 0.0F, static_cast<float>(surface->h));
-        flip.setObstacle(
-            static_cast<double>(mposx) / flip.simScale,
-            (surface->h - static_cast<double>(mposy)) / flip.simScale,
-            /*reset=*/true);
+        input.paused = false;
+        input.dragging = true;
+        input.grabs++;
+        mouse_to_sim();
       }
       if (event.type == SDL_EVENT_MOUSE_BUTTON_UP) {
-        move = false;
-        flip.scene.obstacleVelX = 0.0;
-        flip.scene.obstacleVelY = 0.0;
+        input.dragging = false;
       }
       if (event.type == SDL_EVENT_KEY_DOWN) {
         if (event.key.key == SDLK_B) {
           bordered = !bordered;
           SDL_SetWindowBordered(window, bordered);
         }
+        if (event.key.key == SDLK_G) {
+          // toggle between the software rasterizer and SDL_RenderGeometry
+          gpu = !gpu;
+          tiles.invalidate();
+        }
         if (event.key.key == SDLK_ESCAPE) {
           finished = true;
           break;
@@ -295,102 +578,104 @@ auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
     if (finished) {
       break;
     }
-    if (move) {
-      float mposx {0.0F};
-      float mposy {0.0F};
-      SDL_GetMouseState(&mposx, &mposy);
-      mposx = std::clamp(mposx, 0.0F, static_cast<float>(surface->w));
-      mposy = std::clamp(mposy, 0.0F, static_cast<float>(surface->h));
-      flip.setObstacle(
-          static_cast<double>(mposx) / flip.simScale,
-          (surface->h - static_cast<double>(mposy)) / flip.simScale,
-          /*reset=*/false);
+    if (input.dragging) {
+      mouse_to_sim();
     }
-
-    if (!paused) {
-      flip.simulate();
+    simulation.post(input);
+
+    // never waits, the sim thread may be mid step
+    simulation.update();
+    const auto& frame = simulation.frame();
+
+    if (texture == nullptr || framebuffer.width != surface->w
+        || framebuffer.height != surface->h)
+    {
+      SDL_DestroyTexture(texture);
+      texture = SDL_CreateTexture(renderer,
+                                  SDL_PIXELFORMAT_RGBA32,
+                                  SDL_TEXTUREACCESS_STREAMING,
+                                  surface->w,
+                                  surface->h);
+      pixels.resize(static_cast<std::size_t>(surface->w)
+                    * static_cast<std::size_t>(surface->h));
+      framebuffer = {pixels.data(), surface->w, surface->h, surface->w};
+      tiles.invalidate();
     }
 
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(renderer);
-
-    cmdidx = 0;
-    draw_grid(static_cast<unsigned int>(flip.fNumX),
+    eng.begin({static_cast<std::size_t>(surface->w),
+               static_cast<std::size_t>(surface->h)});
+    draw_grid(eng.commands(),
+              static_cast<unsigned int>(flip.fNumX),
               static_cast<unsigned int>(flip.fNumY),
               static_cast<unsigned int>(surface->w),
               static_cast<unsigned int>(surface->h),
               static_cast<float>(scale),
-              flip.cellColor);
+              frame.cellColor);
 
-    cmdidx = TextCommand::push({15, 15},
-                               0,
-                               {255, 0, 0, 255},
-                               "Hello, World!",
-                               sizeof("Hello, World!"),
-                               (char*)cmdbuf.data(),
-                               cmdidx);
-
-    auto* cmd = std::launder(reinterpret_cast<Command*>(cmdbuf.data()));
-    auto* end = std::launder(reinterpret_cast<Command*>(&cmdbuf.at(cmdidx)));
-
-    while (cmd != end) {
-      switch (cmd->type) {
-        case CommandType::Rectangle: {
-          auto* rectcmd = std::bit_cast<RectCommand*>(cmd);
-          SDL_SetRenderDrawColorFloat(renderer,
-                                      rectcmd->c.x(),
-                                      rectcmd->c.y(),
-                                      rectcmd->c.z(),
-                                      rectcmd->c.w());
-          const SDL_FRect sdl_bbox = {rectcmd->bbox.x(),
-                                      rectcmd->bbox.y(),
-                                      rectcmd->bbox.z(),
-                                      rectcmd->bbox.w()};
-          SDL_RenderFillRect(renderer, &sdl_bbox);
-        } break;
-        case CommandType::Text: {
-          TextCommand* tc = (TextCommand*)cmd;
-          SDL_Color c = {(uint8_t)tc->c.x(),
-                         (uint8_t)tc->c.y(),
-                         (uint8_t)tc->c.z(),
-                         (uint8_t)tc->c.w()};
-          SDL_Surface* surfaceMessage = TTF_RenderText_Shaded(
-              Sans, tc->text, tc->nchar, c, {0, 0, 0, 127});
-          SDL_Rect Message_rect;
-          SDL_GetSurfaceClipRect(surfaceMessage, &Message_rect);
-          SDL_FRect mr {tc->bbox.x(),
-                        tc->bbox.y(),
-                        static_cast<float>(Message_rect.w),
-                        static_cast<float>(Message_rect.h)};
-          SDL_Texture* Message =
-              SDL_CreateTextureFromSurface(renderer, surfaceMessage);
-          SDL_RenderTexture(renderer, Message, NULL, &mr);
-          SDL_DestroySurface(surfaceMessage);
-          SDL_DestroyTexture(Message);
-        } break;
-      }
-      cmd = std::launder(
-          reinterpret_cast<Command*>(std::bit_cast<char*>(cmd) + cmd->size));
-    }
+    eng.commands().push_text({15, 15}, sans, {255, 0, 0, 255}, "Hello, World!");
 
-    const double oxx = flip.scene.obstacleX;
-    const double oyy = flip.scene.obstacleY;
+    const auto& cmds = eng.end();
+
+    const double oxx = frame.obstacleX;
+    const double oyy = frame.obstacleY;
     const double ssx = flip.simWidth;
     const double ssy = flip.simHeight;
+    constexpr auto circle_scale = 10;
+    const Circle circle {
+        static_cast<int>((oxx * surface->w / ssx) - 1.0),
+        static_cast<int>(surface->h - ((oyy * surface->h / ssy) - 1.0)),
+        static_cast<int>(flip.scene.obstacleRadius * flip.fInvSpacing
+                         * circle_scale)};
+    overlay_text.clear();
+    for (const auto& cmd : cmds) {
+      if (cmd.type == CommandType::Text) {
+        append_overlay(overlay_text, static_cast<const TextCommand&>(cmd));
+      }
+    }
 
-    const auto circle_scale = 10;
-
-    draw_circle(renderer,
-                static_cast<int>((oxx * surface->w / ssx) - 1.0),
-                static_cast<int>(surface->h - ((oyy * surface->h / ssy) - 1.0)),
-                static_cast<int>(flip.scene.obstacleRadius * flip.fInvSpacing
-                                 * circle_scale),
-                SDL_ALPHA_OPAQUE,
-                0,
-                0,
-                SDL_ALPHA_OPAQUE);
+    bool present = true;
+    if (gpu) {
+      SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+      SDL_RenderClear(renderer);
+      batcher.render(renderer, cmds, *text);
+    } else {
+      tiles.render(
+          framebuffer, backend::Software_PackColor({0, 0, 0, 1}), cmds);
+      // an unchanged frame is neither uploaded nor presented, the window
+      // keeps showing the previous one. The text and the obstacle outline
+      // are drawn over the texture and are in no tile hash, so the frame is
+      // still presented when only they changed.
+      present =
+          backend::SDL3_Render(renderer, texture, framebuffer, tiles.dirty());
+      if (!present && (circle != shown_circle || overlay_text != shown_text)) {
+        SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+        present = true;
+      }
+      // rectangles are rasterized in software, only text is drawn here
+      if (present) {
+        for (const auto& cmd : cmds) {
+          if (cmd.type == CommandType::Text) {
+            text->draw(static_cast<const TextCommand&>(cmd));
+          }
+        }
+      }
+      text->flush();
+    }
 
-    SDL_RenderPresent(renderer);
+    if (present) {
+      draw_circle(renderer,
+                  circle.x,
+                  circle.y,
+                  circle.radius,
+                  SDL_ALPHA_OPAQUE,
+                  0,
+                  0,
+                  SDL_ALPHA_OPAQUE);
+
+      SDL_RenderPresent(renderer);
+      shown_circle = circle;
+      std::swap(shown_text, overlay_text);
+    }
     constexpr auto delay_frames = 70;
     constexpr auto ms_per_s = 1000.0F;
     if (framecount++ >= delay_frames) {
@@ -398,8 +683,13 @@ auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
       framecount -= delay_frames;
       fps = ms_per_s * static_cast<float>(delay_frames)
           / static_cast<float>(newtime - oldtime);
-      const std::string newt = std::string("Flip Fluid Sim (")
-          + std::to_string(static_cast<int>(fps)) + std::string(" fps)");
+      const std::string newt =
+          std::format("Flip Fluid Sim ({} fps, {} substeps, {} pressure "
+                      "iterations, residual {:.1e})",
+                      static_cast<int>(fps),
+                      frame.subSteps,
+                      frame.pressureStats.iterations,
+                      frame.pressureStats.residual);
       SDL_SetWindowTitle(window, newt.c_str());
     }
     constexpr auto fpslimit = 60.0F;
@@ -410,6 +700,10 @@ auto main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) -> int
     }
   }
 
+  text.reset();
+  ttf.reset();
+  TTF_Quit();
+  SDL_DestroyTexture(texture);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
 
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <backend/software/raster.hpp>
+#include <backend/software/tiler.hpp>
+#include <engine/arena.hpp>
+#include <engine/command_buffer.hpp>
+#include <engine/command_store.hpp>
+#include <engine/thread_pool.hpp>
+
+// Rasterizes a 4K frame of random rectangles, first on one thread with
+// Software_Render from the interleaved buffer and from column storage, then
+// tile-binned on thread pools of growing size.
+//
+// usage: raster_bench [rects] [frames]
+
+namespace
+{
+constexpr int width = 3840;
+constexpr int height = 2160;
+
+template<typename F>
+auto time_frames(int frames, F&& f) -> double
+{
+  f();  // warm up
+  const auto start = std::chrono::steady_clock::now();
+  for (auto i = 0; i < frames; i++) {
+    f();
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / frames;
+}
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  const std::size_t nrects = argc > 1 ? std::stoul(argv[1]) : 200000;
+  const int frames = argc > 2 ? std::stoi(argv[2]) : 10;
+
+  engine::Arena arena(std::pmr::new_delete_resource());
+  engine::CommandBuffer commands(arena);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> px(0.0F, width);
+  std::uniform_real_distribution<float> py(0.0F, height);
+  std::uniform_real_distribution<float> size(2.0F, 48.0F);
+  std::uniform_real_distribution<float> unit(0.0F, 1.0F);
+  for (auto i = 0UL; i < nrects; i++) {
+    commands.push_rect(
+        {px(rng), py(rng), size(rng), size(rng)},
+        {unit(rng), unit(rng), unit(rng), i % 4 == 0 ? 0.5F : 1.0F});
+  }
+
+  std::vector<std::uint32_t> pixels(static_cast<std::size_t>(width) * height);
+  backend::Framebuffer fb {pixels.data(), width, height, width};
+  const auto black = backend::Software_PackColor({0, 0, 0, 1});
+
+  const auto serial = time_frames(frames,
+                                  [&]
+                                  {
+                                    backend::Software_Clear(fb, black);
+                                    backend::Software_Render(fb, commands);
+                                  });
+  std::printf("%zu rects %dx%d\n", nrects, width, height);
+  std::printf("serial       %8.2f ms\n", serial);
+
+  engine::CommandStore store;
+  store.append(commands);
+  const auto soa = time_frames(frames,
+                               [&]
+                               {
+                                 backend::Software_Clear(fb, black);
+                                 backend::Software_Render(fb, store);
+                               });
+  std::printf("serial soa   %8.2f ms  %5.2fx\n", soa, serial / soa);
+
+  const auto maxthreads = std::max(1U, std::thread::hardware_concurrency());
+  std::vector<unsigned int> counts;
+  for (auto n = 1U; n < maxthreads; n *= 2) {
+    counts.push_back(n);
+  }
+  counts.push_back(maxthreads);
+
+  for (auto n : counts) {
+    engine::ThreadPool pool(n);
+    backend::TileRenderer tiles(pool);
+    const auto ms = time_frames(frames,
+                                [&]
+                                {
+                                  // retained tiles would make every frame
+                                  // after the first free
+                                  tiles.invalidate();
+                                  tiles.render(fb, black, commands);
+                                });
+    std::printf("tiled %3u thr %8.2f ms  %5.2fx\n", n, ms, serial / ms);
+  }
+  return 0;
+}
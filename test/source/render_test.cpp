@@ -1,4 +1,572 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory_resource>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <backend/software/raster.hpp>
+#include <backend/software/tiler.hpp>
+#include <engine/arena.hpp>
+#include <engine/command_buffer.hpp>
+#include <engine/command_store.hpp>
+#include <engine/thread_pool.hpp>
+#include <engine/triple_buffer.hpp>
+#include <flip/active_blocks.hpp>
+#include <flip/flip.hpp>
+#include <flip/kernels.hpp>
+#include <flip/obstacles.hpp>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+  if (!ok) {
+    std::printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+void test_arena_fixed()
+{
+  alignas(std::max_align_t) std::array<std::byte, 64> buf {};
+  engine::Arena arena(buf);
+  check(arena.aligned_alloc(48, 8) != nullptr, "fixed arena fits");
+  check(arena.aligned_alloc(32, 8) == nullptr, "fixed arena respects size");
+  arena.reset();
+  check(arena.aligned_alloc(64, 8) != nullptr, "fixed arena reset");
+}
+
+void test_arena_chained()
+{
+  std::pmr::monotonic_buffer_resource upstream;
+  alignas(std::max_align_t) std::array<std::byte, 64> buf {};
+  engine::Arena arena(buf.data(), buf.size(), &upstream, 256);
+  for (auto i = 0; i < 16; i++) {
+    check(arena.aligned_alloc(48, 8) != nullptr, "chained arena grows");
+  }
+  const auto grown = arena.stats();
+  check(grown.chunks > 0, "chained arena allocates chunks");
+  check(grown.used >= 16 * 48, "chained arena counts usage");
+
+  arena.reset();
+  for (auto i = 0; i < 16; i++) {
+    arena.aligned_alloc(48, 8);
+  }
+  const auto steady = arena.stats();
+  check(steady.chunks == grown.chunks, "chained arena reuses chunks");
+  check(steady.last_frame == grown.used, "chained arena reports last frame");
+  check(steady.peak >= steady.last_frame, "chained arena tracks peak");
+}
+
+void test_command_buffer()
+{
+  std::pmr::monotonic_buffer_resource upstream;
+  engine::Arena arena(&upstream, 256);
+  engine::CommandBuffer cmds(arena);
+  for (auto i = 0; i < 100; i++) {
+    if (i % 3 == 0) {
+      cmds.push_text({0, 0}, i, {1, 1, 1, 1}, "variable length text");
+    } else {
+      cmds.push_rect({static_cast<float>(i), 0, 1, 1}, {1, 1, 1, 1});
+    }
+  }
+  check(cmds.size() == 100, "command buffer counts commands");
+
+  auto i = 0;
+  auto ok = true;
+  for (const auto& cmd : cmds) {
+    if (i % 3 == 0) {
+      const auto& tc = static_cast<const engine::TextCommand&>(cmd);
+      ok = ok && cmd.type == engine::CommandType::Text && tc.font == i
+          && std::strcmp(tc.text, "variable length text") == 0;
+    } else {
+      ok = ok && cmd.type == engine::CommandType::Rectangle
+          && static_cast<int>(cmd.bbox.x()) == i;
+    }
+    i++;
+  }
+  check(ok && i == 100, "command buffer iterates records in order");
+
+  cmds.clear();
+  check(cmds.empty() && cmds.begin() == cmds.end(), "command buffer clears");
+}
+
+void test_triple_buffer()
+{
+  engine::TripleBuffer<int> buf(0);
+  check(!buf.update() && buf.read_buffer() == 0, "triple buffer starts empty");
+  buf.write_buffer() = 1;
+  buf.publish();
+  buf.write_buffer() = 2;
+  buf.publish();
+  check(buf.update() && buf.read_buffer() == 2, "triple buffer reads latest");
+  check(!buf.update() && buf.read_buffer() == 2, "triple buffer keeps value");
+
+  // every value the reader sees is whole and never older than the last one
+  engine::TripleBuffer<std::array<int, 64>> frames;
+  constexpr auto count = 20000;
+  std::thread writer(
+      [&]
+      {
+        for (auto i = 1; i <= count; i++) {
+          frames.write_buffer().fill(i);
+          frames.publish();
+        }
+      });
+  auto last = 0;
+  auto ok = true;
+  while (last < count) {
+    if (frames.update()) {
+      const auto& f = frames.read_buffer();
+      ok = ok && f.front() >= last && f.front() == f.back();
+      last = f.front();
+    }
+  }
+  writer.join();
+  check(ok, "triple buffer hands over complete values in order");
+}
+
+// Frames that end mid-tile on both axes
+constexpr int frame_width = 300;
+constexpr int frame_height = 200;
+constexpr std::uint32_t frame_clear = 0xff302010;
+
+// Random rectangles crossing tile and frame edges, every fourth translucent.
+// Rectangle number moved, when given, is shifted right by 7 pixels.
+void push_random_rects(engine::CommandBuffer& cmds,
+                       unsigned seed,
+                       int moved = -1)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> px(-40.0F, frame_width);
+  std::uniform_real_distribution<float> py(-40.0F, frame_height);
+  std::uniform_real_distribution<float> size(1.0F, 120.0F);
+  std::uniform_real_distribution<float> unit(0.0F, 1.0F);
+  for (auto i = 0; i < 400; i++) {
+    const auto x = px(rng) + (i == moved ? 7.0F : 0.0F);
+    cmds.push_rect({x, py(rng), size(rng), size(rng)},
+                   {unit(rng), unit(rng), unit(rng), i % 4 == 0 ? 0.5F : 1.0F});
+  }
+}
+
+struct Frame
+{
+  std::vector<std::uint32_t> pixels =
+      std::vector<std::uint32_t>(frame_width * frame_height);
+  backend::Framebuffer fb {
+      pixels.data(), frame_width, frame_height, frame_width};
+};
+
+// The single-threaded output every renderer has to reproduce
+auto render_reference(const engine::CommandBuffer& cmds)
+    -> std::vector<std::uint32_t>
+{
+  Frame ref;
+  backend::Software_Clear(ref.fb, frame_clear);
+  backend::Software_Render(ref.fb, cmds);
+  return ref.pixels;
+}
+
+void test_tiled_render()
+{
+  engine::Arena arena(std::pmr::new_delete_resource());
+  engine::CommandBuffer cmds(arena);
+  push_random_rects(cmds, 1);
+
+  engine::ThreadPool pool(3);
+  backend::TileRenderer tiler(pool);
+  Frame frame;
+  tiler.render(frame.fb, frame_clear, cmds);
+  check(frame.pixels == render_reference(cmds),
+        "tiled render matches Software_Render");
+}
+
+// The retained framebuffer only redraws the tiles whose commands changed
+void test_tiled_rerender()
+{
+  engine::Arena arena(std::pmr::new_delete_resource());
+  engine::CommandBuffer cmds(arena);
+  engine::ThreadPool pool(3);
+  backend::TileRenderer tiler(pool);
+  Frame frame;
+  push_random_rects(cmds, 2);
+  tiler.render(frame.fb, frame_clear, cmds);
+  const auto before = frame.pixels;
+
+  // the last rectangle is drawn on top of the others
+  cmds.clear();
+  push_random_rects(cmds, 2, 399);
+  tiler.render(frame.fb, frame_clear, cmds);
+  check(frame.pixels != before && frame.pixels == render_reference(cmds),
+        "tiled re-render of a changed command matches Software_Render");
+
+  tiler.render(frame.fb, frame_clear, cmds);
+  check(tiler.dirty().empty() && frame.pixels == render_reference(cmds),
+        "tiled re-render of an identical frame redraws nothing");
+}
+
+// Every pixel a render changes lies in one of the dirty() rectangles, and the
+// rectangles never overlap
+void test_tiled_dirty()
+{
+  engine::Arena arena(std::pmr::new_delete_resource());
+  engine::CommandBuffer cmds(arena);
+  engine::ThreadPool pool(3);
+  backend::TileRenderer tiler(pool);
+  Frame frame;
+  push_random_rects(cmds, 3);
+  tiler.render(frame.fb, frame_clear, cmds);
+
+  auto covered = true;
+  auto disjoint = true;
+  // each step moves one rectangle and puts the one before back
+  for (const auto moved : {399, 12, 250, 398, 77}) {
+    const auto before = frame.pixels;
+    cmds.clear();
+    push_random_rects(cmds, 3, moved);
+    tiler.render(frame.fb, frame_clear, cmds);
+    const auto& dirty = tiler.dirty();
+
+    for (auto y = 0; y < frame_height; y++) {
+      for (auto x = 0; x < frame_width; x++) {
+        const auto i = static_cast<std::size_t>(y * frame_width + x);
+        if (frame.pixels[i] == before[i]) {
+          continue;
+        }
+        const auto inside = [&](const backend::ClipRect& r)
+        { return x >= r.x0 && x < r.x1 && y >= r.y0 && y < r.y1; };
+        covered = covered && std::any_of(dirty.begin(), dirty.end(), inside);
+      }
+    }
+    for (auto a = 0UL; a < dirty.size(); a++) {
+      for (auto b = a + 1; b < dirty.size(); b++) {
+        disjoint = disjoint
+            && (dirty[a].x1 <= dirty[b].x0 || dirty[b].x1 <= dirty[a].x0
+                || dirty[a].y1 <= dirty[b].y0 || dirty[b].y1 <= dirty[a].y0);
+      }
+    }
+  }
+  check(covered, "tiled render changes pixels only inside dirty()");
+  check(disjoint, "tiled render dirty() rectangles are disjoint");
+}
+
+// Column storage draws its rectangles like the buffer it was appended from;
+// the text in between moves to its own columns and is not rasterized
+void test_store_render()
+{
+  engine::Arena arena(std::pmr::new_delete_resource());
+  engine::CommandBuffer cmds(arena);
+  push_random_rects(cmds, 4);
+  cmds.push_text({10, 10}, 0, {1, 1, 1, 1}, "text");
+  push_random_rects(cmds, 5);
+
+  engine::CommandStore store;
+  store.append(cmds);
+  Frame frame;
+  backend::Software_Clear(frame.fb, frame_clear);
+  backend::Software_Render(frame.fb, store);
+  check(store.rects.size() == 800 && store.texts.size() == 1
+            && frame.pixels == render_reference(cmds),
+        "command store renders like its command buffer");
+}
+
+void test_active_blocks()
+{
+  // 5 x 3 blocks, all active after init()
+  sim::ActiveBlocks blocks;
+  blocks.init(40, 24);
+  check(blocks.list.size() == 15, "active blocks start out all active");
+
+  // a mark activates its block and the blocks around it
+  blocks.mark(1, 1);
+  blocks.update();
+  check(blocks.list == std::vector<int> {0, 1, 3, 4},
+        "active blocks are the marked ones dilated by one");
+  check(blocks.released.size() == 11, "active blocks release the rest");
+  check(blocks.rowBegin[15] == 0 && blocks.rowEnd[15] == 16
+            && blocks.rowEnd[16] == 0,
+        "active blocks give the rows of each column");
+  check(blocks.boundsX1 == 16 && blocks.boundsY1 == 16,
+        "active blocks give the box around them");
+  check(blocks.touchedBlocks().size() == 15,
+        "active blocks remember blocks touched before");
+
+  blocks.clearTouched();
+  blocks.update();
+  check(blocks.list.empty() && blocks.released.size() == 4
+            && blocks.touchedBlocks().size() == 4,
+        "active blocks empty out without marks");
+}
+
+// Moves overlapping obstacles around and checks the incrementally
+// rasterized s against every SDF sampled at every cell
+void test_obstacles()
+{
+  constexpr std::size_t cells = 40;
+  constexpr float h = 0.1F;
+  std::vector<float> s(cells * cells, 1.0F);
+  std::vector<sim::CellType> type(cells * cells, sim::CellType::AIR);
+  sim::ActiveBlocks blocks;
+  blocks.init(static_cast<int>(cells), static_cast<int>(cells));
+  sim::ObstacleSet<float> obstacles;
+  obstacles.init(static_cast<int>(cells), static_cast<int>(cells), h);
+  using Obstacle = sim::Obstacle<float>;
+  obstacles.add(Obstacle::circle(0.6F));
+  obstacles.add(Obstacle::box(0.5F, 0.3F));
+  obstacles.add(Obstacle::polygon({-0.5F, 0.6F, 0.0F}, {-0.4F, -0.3F, 0.7F}));
+
+  bool exact = true;
+  for (auto step = 0UL; step < 30; step++) {
+    for (auto k = 0UL; k < obstacles.list.size(); k++) {
+      // every third step one obstacle stays put
+      if ((step + k) % 3 != 0) {
+        obstacles.list[k].x = 1.5F + 0.1F * static_cast<float>(step + k);
+        obstacles.list[k].y = 2.0F + 0.05F * static_cast<float>(step * k);
+      }
+    }
+    obstacles.rasterize(s, type, blocks);
+
+    for (auto i = 1UL; i + 1 < cells; i++) {
+      for (auto j = 1UL; j + 1 < cells; j++) {
+        const auto x = (static_cast<float>(i) + 0.5F) * h;
+        const auto y = (static_cast<float>(j) + 0.5F) * h;
+        bool inside = false;
+        for (const auto& o : obstacles.list) {
+          inside = inside || o.distance(x, y) < 0.0F;
+        }
+        exact = exact && (s[i * cells + j] < 0.5F) == inside;
+      }
+    }
+  }
+  check(exact, "obstacles rasterize the cells inside them");
+}
+
+void test_pressure_early_exit()
+{
+  using Fluid = sim::FlipFluid<float>;
+  for (const auto solver : {Fluid::GAUSS_SEIDEL, Fluid::RED_BLACK}) {
+    Fluid flip {320.0F, 320.0F, 16};
+    flip.scene.pressureSolver = solver;
+    flip.scene.numPressureIters = 50;
+    for (auto i = 0; i < 60; i++) {
+      flip.simulate();
+    }
+    check(flip.pressureStats.iterations > 0
+              && flip.pressureStats.iterations < 50 * flip.subSteps,
+          "SOR pressure solves stop once the divergence has dropped");
+  }
+}
+
+// One red-black iteration of the AVX2 sweep, split into two column ranges
+// the way the workers share it, against the scalar relaxCell loop
+template<typename T>
+void test_pressure_sweep(const char* what)
+{
+  if (!sim::hasAVX2()) {
+    return;
+  }
+  sim::FlipFluid<T> stepped {T(640), T(360), 32};
+  stepped.scene.deterministic = true;
+  for (auto i = 0; i < 5; i++) {
+    stepped.simulate();
+  }
+  const T cp = stepped.density * stepped.h / stepped.scene.dt;
+  const T omega = stepped.scene.overRelaxation;
+
+  auto scalar = stepped;
+  T scalarMax = 0;
+  for (auto color = 0; color < 2; color++) {
+    for (auto i = 1; i < scalar.fNumX - 1; i++) {
+      for (auto j = 1 + ((i + 1 + color) & 1); j < scalar.fNumY - 1; j += 2)
+      {
+        scalarMax = std::max(scalarMax, scalar.relaxCell(i, j, cp, omega));
+      }
+    }
+  }
+
+  auto simd = stepped;
+  const sim::PressureSweep<T> sweep {simd.u.data(),
+                                     simd.v.data(),
+                                     simd.p.data(),
+                                     simd.s.data(),
+                                     simd.particleDensity.data(),
+                                     simd.cellType.data(),
+                                     nullptr,
+                                     nullptr,
+                                     static_cast<std::size_t>(simd.fNumY),
+                                     cp,
+                                     omega,
+                                     simd.particleRestDensity};
+  const auto nx = static_cast<std::size_t>(simd.fNumX);
+  const auto k = nx / 2 + 1;
+  T simdMax = 0;
+  for (auto color = 0; color < 2; color++) {
+    simdMax = std::max(simdMax, sim::sweepPressureAVX2(sweep, color, 1, k));
+    simdMax =
+        std::max(simdMax, sim::sweepPressureAVX2(sweep, color, k, nx - 1));
+  }
+
+  auto same = [](const auto& a, const auto& b)
+  {
+    return a.size() == b.size()
+        && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+  };
+  check(same(scalar.u, simd.u) && same(scalar.v, simd.v)
+            && same(scalar.p, simd.p) && !(scalarMax < simdMax)
+            && !(simdMax < scalarMax),
+        what);
+}
+
+// The particle kernels plus the scalar tail against the scalar loops alone,
+// over a range that starts off a register and ends mid-register
+template<typename T>
+void test_particle_kernels(const char* what)
+{
+  constexpr std::size_t count = 1003;
+  constexpr std::size_t begin = 3;
+  const T dt = T(1) / T(120);
+  const T gravity = T(-9.81);
+  const sim::ParticleCollision<T> walls {T(0.1), T(0.9), T(0.1), T(0.9)};
+
+  sim::ParticleColumns<T> ref;
+  ref.resize(count);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<T> pos(T(-0.2), T(1.2));
+  std::uniform_real_distribution<T> vel(T(-5), T(5));
+  for (auto i = 0UL; i < count; i++) {
+    ref.x[i] = pos(rng);
+    ref.y[i] = pos(rng);
+    ref.vx[i] = vel(rng);
+    ref.vy[i] = vel(rng);
+  }
+  auto simd = ref;
+
+  for (auto i = begin; i < count; i++) {
+    ref.vy[i] += dt * gravity;
+    ref.x[i] += ref.vx[i] * dt;
+    ref.y[i] += ref.vy[i] * dt;
+  }
+  for (auto i = begin; i < count; i++) {
+    if (ref.x[i] < walls.minX) {
+      ref.x[i] = walls.minX;
+      ref.vx[i] = 0;
+    }
+    if (ref.x[i] > walls.maxX) {
+      ref.x[i] = walls.maxX;
+      ref.vx[i] = 0;
+    }
+    if (ref.y[i] < walls.minY) {
+      ref.y[i] = walls.minY;
+      ref.vy[i] = 0;
+    }
+    if (ref.y[i] > walls.maxY) {
+      ref.y[i] = walls.maxY;
+      ref.vy[i] = 0;
+    }
+  }
+
+  auto i = sim::integrateParticlesSIMD(simd, begin, count, dt, gravity);
+  for (; i < count; i++) {
+    simd.vy[i] += dt * gravity;
+    simd.x[i] += simd.vx[i] * dt;
+    simd.y[i] += simd.vy[i] * dt;
+  }
+  i = sim::collideParticlesSIMD(simd, begin, count, walls);
+  for (; i < count; i++) {
+    if (simd.x[i] < walls.minX) {
+      simd.x[i] = walls.minX;
+      simd.vx[i] = 0;
+    }
+    if (simd.x[i] > walls.maxX) {
+      simd.x[i] = walls.maxX;
+      simd.vx[i] = 0;
+    }
+    if (simd.y[i] < walls.minY) {
+      simd.y[i] = walls.minY;
+      simd.vy[i] = 0;
+    }
+    if (simd.y[i] > walls.maxY) {
+      simd.y[i] = walls.maxY;
+      simd.vy[i] = 0;
+    }
+  }
+
+  auto same = true;
+  for (const auto col : {&sim::ParticleColumns<T>::x,
+                         &sim::ParticleColumns<T>::y,
+                         &sim::ParticleColumns<T>::vx,
+                         &sim::ParticleColumns<T>::vy})
+  {
+    same = same
+        && std::memcmp((ref.*col).data(),
+                       (simd.*col).data(),
+                       count * sizeof(T))
+            == 0;
+  }
+  check(same, what);
+}
+
+// positions and velocities after a few frames of the default scene
+std::vector<float> run_flip(engine::ThreadPool* pool)
+{
+  sim::FlipFluid<float> flip {640.0F, 360.0F, 32};
+  flip.scene.deterministic = true;
+  flip.setThreadPool(pool);
+  for (auto i = 0; i < 20; i++) {
+    flip.simulate();
+  }
+
+  std::vector<float> out;
+  const auto n = flip.numParticles;
+  for (const auto* col : {&flip.particles.x,
+                          &flip.particles.y,
+                          &flip.particles.vx,
+                          &flip.particles.vy})
+  {
+    out.insert(out.end(), col->begin(), col->begin() + n);
+  }
+  return out;
+}
+
+void test_flip_deterministic()
+{
+  const auto serial = run_flip(nullptr);
+  engine::ThreadPool pool(3);
+  const auto threaded = run_flip(&pool);
+  check(serial.size() == threaded.size()
+            && std::memcmp(serial.data(),
+                           threaded.data(),
+                           serial.size() * sizeof(float))
+                == 0,
+        "deterministic flip matches across thread counts");
+}
+}  // namespace
+
 auto main() -> int
 {
-  return 0;
+  test_arena_fixed();
+  test_arena_chained();
+  test_command_buffer();
+  test_triple_buffer();
+  test_tiled_render();
+  test_tiled_rerender();
+  test_tiled_dirty();
+  test_store_render();
+  test_active_blocks();
+  test_obstacles();
+  test_pressure_early_exit();
+  test_pressure_sweep<float>("AVX2 float sweep matches relaxCell");
+  test_pressure_sweep<double>("AVX2 double sweep matches relaxCell");
+  test_particle_kernels<float>("float particle kernels match the scalar loops");
+  test_particle_kernels<double>(
+      "double particle kernels match the scalar loops");
+  test_flip_deterministic();
+  return failures == 0 ? 0 : 1;
 }